@@ -0,0 +1,2451 @@
+/**
+ * ╔══════════════════════════════════════════════════════════════════════════════╗
+ * ║                     HUFFMAN CODER - CODING ENGINE                            ║
+ * ╚══════════════════════════════════════════════════════════════════════════════╝
+ * 
+ * Header-only Huffman engine shared by the server and the benchmarks:
+ * tree arena, packed bit I/O, table-driven decoder, histogram, CRC32C,
+ * optimal and length-limited code lengths, JSON writer, HuffmanCoder itself
+ * (bytes), CodePointCoder (UTF-8 code points) and the one-pass
+ * AdaptiveHuffmanCoder.
+ * No sockets, threads or I/O; include it and compile as usual. Kernels
+ * for newer CPUs are compiled with per-function target attributes and
+ * picked at run time, so no -m flags are needed either.
+ */
+
+#ifndef HUFFMAN_CODER_H
+#define HUFFMAN_CODER_H
+
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <unordered_map>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+    #define HUFFMAN_HAVE_SSE2
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    #define HUFFMAN_X86
+    #if defined(_MSC_VER) && !defined(HUFFMAN_HAVE_SSE2)
+        #include <intrin.h>
+    #endif
+#endif
+
+#if defined(HUFFMAN_X86) && (defined(__GNUC__) || defined(__clang__))
+    #define HUFFMAN_HAVE_BMI2_KERNEL
+    #define HUFFMAN_TARGET_BMI2 __attribute__((target("bmi2")))
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #include <nmmintrin.h>
+    #define HUFFMAN_HAVE_CRC32C_KERNEL
+    #define HUFFMAN_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+
+#if defined(_MSC_VER)
+    #define HUFFMAN_FORCE_INLINE __forceinline
+#elif defined(__GNUC__) || defined(__clang__)
+    #define HUFFMAN_FORCE_INLINE inline __attribute__((always_inline))
+#else
+    #define HUFFMAN_FORCE_INLINE inline
+#endif
+
+using namespace std;
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              HUFFMAN NODE STRUCTURE
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Tree nodes live in a fixed arena inside HuffmanTree and refer to their
+ * children by 16-bit index. A byte alphabet needs at most 511 nodes.
+ */
+static const uint16_t kNullNode = 0xFFFF;
+
+struct HuffmanNode {
+    uint8_t symbol;
+    uint32_t freq;
+    uint16_t left;
+    uint16_t right;
+    
+    bool isLeaf() const {
+        return left == kNullNode && right == kNullNode;
+    }
+};
+
+class HuffmanTree {
+public:
+    static const size_t kMaxNodes = 511;
+    
+private:
+    HuffmanNode nodes[kMaxNodes];
+    uint16_t nodeCount;
+    uint16_t rootIndex;
+    
+public:
+    HuffmanTree() : nodeCount(0), rootIndex(kNullNode) {}
+    
+    // Teardown is just forgetting the nodes
+    void clear() {
+        nodeCount = 0;
+        rootIndex = kNullNode;
+    }
+    
+    uint16_t addNode(uint8_t symbol, uint32_t freq, uint16_t left = kNullNode, uint16_t right = kNullNode) {
+        HuffmanNode& node = nodes[nodeCount];
+        node.symbol = symbol;
+        node.freq = freq;
+        node.left = left;
+        node.right = right;
+        return nodeCount++;
+    }
+    
+    HuffmanNode& operator[](uint16_t index) {
+        return nodes[index];
+    }
+    
+    const HuffmanNode& operator[](uint16_t index) const {
+        return nodes[index];
+    }
+    
+    bool empty() const {
+        return rootIndex == kNullNode;
+    }
+    
+    uint16_t root() const {
+        return rootIndex;
+    }
+    
+    void setRoot(uint16_t index) {
+        rootIndex = index;
+    }
+};
+
+/**
+ * Flat code table entry, indexed by byte value. Codes are right-aligned in
+ * 'bits'; len == 0 marks a byte that does not occur.
+ */
+struct HuffmanCode {
+    uint32_t bits;
+    uint8_t len;
+    
+    HuffmanCode() : bits(0), len(0) {}
+};
+
+// Codes must fit the 32-bit code field (and a single BitWriter::write).
+// buildTree limits lengths to kDefaultMaxCodeLength unless told otherwise.
+static const unsigned kMaxCodeLength = 32;
+static const unsigned kDefaultMaxCodeLength = 15;
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              PACKED BIT WRITER
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Appends codes MSB-first into a 64-bit accumulator and flushes whole 32-bit
+ * words to the output buffer. The bit order matches the '0'/'1' string form,
+ * so the packed bytes are exactly that string read eight characters at a time.
+ */
+class BitWriter {
+private:
+    string& out;
+    uint64_t accumulator;
+    unsigned bitCount;      // Pending bits in the accumulator (always < 32)
+    uint64_t totalBits;
+    
+public:
+    explicit BitWriter(string& output) : out(output), accumulator(0), bitCount(0), totalBits(0) {}
+    
+    // Writes the low 'len' bits of 'bits' (len <= 32)
+    void write(uint32_t bits, unsigned len) {
+        accumulator = (accumulator << len) | bits;
+        bitCount += len;
+        totalBits += len;
+        if (bitCount >= 32) {
+            bitCount -= 32;
+            uint32_t word = (uint32_t)(accumulator >> bitCount);
+            char bytes[4] = {
+                (char)(word >> 24), (char)(word >> 16), (char)(word >> 8), (char)word
+            };
+            out.append(bytes, 4);
+        }
+    }
+    
+    // Writes the remaining bits, zero-padded to a whole byte
+    void flush() {
+        while (bitCount >= 8) {
+            bitCount -= 8;
+            out += (char)(accumulator >> bitCount);
+        }
+        if (bitCount > 0) {
+            out += (char)(accumulator << (8 - bitCount));
+            bitCount = 0;
+        }
+        accumulator = 0;
+    }
+    
+    uint64_t getTotalBits() const {
+        return totalBits;
+    }
+};
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              ENCODE KERNELS
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Eight bytes as one big-endian word (one load and a byte swap)
+static HUFFMAN_FORCE_INLINE uint64_t loadBigEndian64(const unsigned char* p) {
+    uint64_t word;
+    memcpy(&word, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return word;
+#elif defined(__GNUC__) || defined(__clang__)
+    return __builtin_bswap64(word);
+#elif defined(_MSC_VER)
+    return _byteswap_uint64(word);
+#else
+    word = 0;
+    for (int i = 0; i < 8; i++) word = (word << 8) | p[i];
+    return word;
+#endif
+}
+
+static HUFFMAN_FORCE_INLINE void storeBigEndian64(unsigned char* p, uint64_t word) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#elif defined(__GNUC__) || defined(__clang__)
+    word = __builtin_bswap64(word);
+#elif defined(_MSC_VER)
+    word = _byteswap_uint64(word);
+#else
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(word >> (56 - 8 * i));
+    return;
+#endif
+    memcpy(p, &word, 8);
+}
+
+/**
+ * Encode table entry: the code left-aligned in the top 32 bits and its
+ * length in the low byte, so one load gives both and an unused symbol
+ * (entry 0) writes nothing.
+ */
+static const uint64_t kEncodeCodeMask = 0xFFFFFFFF00000000ull;
+
+static inline uint64_t makeEncodeEntry(uint32_t bits, unsigned length) {
+    return length == 0 ? 0 : ((uint64_t)bits << (64 - length)) | length;
+}
+
+/**
+ * The accumulator keeps pending bits left-aligned. Group codes are ORed
+ * in below them, then all eight bytes are stored and the output advances
+ * by the whole bytes only, leaving fewer than 8 bits pending. Group is
+ * chosen so that 7 + Group * maxLength <= 63: no bounds checks or
+ * variable-count loops on the way. The store can run 8 bytes past the
+ * bytes kept, so callers leave that much slack.
+ */
+template<unsigned Group>
+static HUFFMAN_FORCE_INLINE unsigned char* encodeGroups(const uint64_t* table, const unsigned char* data,
+                                                        size_t& i, size_t length, unsigned char* out,
+                                                        uint64_t& pending, unsigned& pendingBits) {
+    uint64_t accumulator = pending;
+    unsigned bits = pendingBits;
+    for (; i + Group <= length; i += Group) {
+        for (unsigned k = 0; k < Group; k++) {
+            uint64_t entry = table[data[i + k]];
+            accumulator |= (entry & kEncodeCodeMask) >> bits;
+            bits += (uint8_t)entry;
+        }
+        storeBigEndian64(out, accumulator);
+        out += bits >> 3;
+        accumulator <<= bits & ~7u;
+        bits &= 7;
+    }
+    pending = accumulator;
+    pendingBits = bits;
+    return out;
+}
+
+/**
+ * Instantiations by group size, fixed at compile time so the group loop
+ * unrolls completely. A coder picks one per code table from its longest
+ * code (encodeGroupIndex) instead of testing the length on every call.
+ */
+static const size_t kEncodeGroupClasses = 5;        // groups of 8, 4, 3, 2 and 1
+
+static inline size_t encodeGroupIndex(unsigned maxLength) {
+    return maxLength <= 7 ? 0 : maxLength <= 14 ? 1 : maxLength <= 18 ? 2 : maxLength <= 28 ? 3 : 4;
+}
+
+template<unsigned Group>
+static HUFFMAN_FORCE_INLINE unsigned char* encodeSymbolsWith(const uint64_t* table, const unsigned char* data,
+                                                             size_t length, unsigned char* out,
+                                                             uint64_t& pending, unsigned& pendingBits) {
+    size_t i = 0;
+    if (Group > 1) out = encodeGroups<Group>(table, data, i, length, out, pending, pendingBits);
+    return encodeGroups<1>(table, data, i, length, out, pending, pendingBits);
+}
+
+/**
+ * Encodes data[0..length) at 'out' (plus 8 bytes of slack) and returns
+ * the end of the whole bytes written; fewer than 8 bits stay in
+ * pending/pendingBits for the next call. Codes must fit the group size
+ * the kernel was instantiated for.
+ */
+typedef unsigned char* (*EncodeKernel)(const uint64_t* table, const unsigned char* data, size_t length,
+                                       unsigned char* out, uint64_t& pending, unsigned& pendingBits);
+
+template<unsigned Group>
+static unsigned char* encodeSymbolsScalar(const uint64_t* table, const unsigned char* data, size_t length,
+                                          unsigned char* out, uint64_t& pending, unsigned& pendingBits) {
+    return encodeSymbolsWith<Group>(table, data, length, out, pending, pendingBits);
+}
+
+#ifdef HUFFMAN_HAVE_BMI2_KERNEL
+// Same loop; with BMI2 the variable shifts compile to SHRX/SHLX, which do
+// not go through CL and flags and take one uop instead of three
+template<unsigned Group>
+HUFFMAN_TARGET_BMI2
+static unsigned char* encodeSymbolsBmi2(const uint64_t* table, const unsigned char* data, size_t length,
+                                        unsigned char* out, uint64_t& pending, unsigned& pendingBits) {
+    return encodeSymbolsWith<Group>(table, data, length, out, pending, pendingBits);
+}
+#endif
+
+static inline bool cpuHasBmi2() {
+#if defined(HUFFMAN_X86) && defined(_MSC_VER)
+    int registers[4];
+    __cpuid(registers, 0);
+    if (registers[0] < 7) return false;
+    __cpuidex(registers, 7, 0);
+    return (registers[1] & (1 << 8)) != 0;
+#elif defined(HUFFMAN_HAVE_BMI2_KERNEL)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("bmi2") != 0;
+#else
+    return false;
+#endif
+}
+
+struct CodingKernels {
+    const char* name;
+    EncodeKernel encode[kEncodeGroupClasses];     // by encodeGroupIndex()
+};
+
+static const CodingKernels kScalarKernels = { "scalar", {
+    encodeSymbolsScalar<8>, encodeSymbolsScalar<4>, encodeSymbolsScalar<3>,
+    encodeSymbolsScalar<2>, encodeSymbolsScalar<1>
+} };
+#ifdef HUFFMAN_HAVE_BMI2_KERNEL
+static const CodingKernels kBmi2Kernels = { "bmi2", {
+    encodeSymbolsBmi2<8>, encodeSymbolsBmi2<4>, encodeSymbolsBmi2<3>,
+    encodeSymbolsBmi2<2>, encodeSymbolsBmi2<1>
+} };
+#endif
+
+// Kernels by name, or nullptr if this build or CPU cannot run them
+inline const CodingKernels* findCodingKernels(const string& name) {
+    if (name == "scalar") return &kScalarKernels;
+#ifdef HUFFMAN_HAVE_BMI2_KERNEL
+    if (name == "bmi2" && cpuHasBmi2()) return &kBmi2Kernels;
+#endif
+    return nullptr;
+}
+
+inline const CodingKernels*& activeCodingKernels() {
+    static const CodingKernels* kernels = findCodingKernels("bmi2") ? findCodingKernels("bmi2") 
+                                                                    : &kScalarKernels;
+    return kernels;
+}
+
+// The kernels every coder uses; picked from the CPU on first use
+inline const CodingKernels& codingKernels() {
+    return *activeCodingKernels();
+}
+
+// Overrides the CPU choice (benchmarks, tests). Call before any coding
+// threads start; returns false for kernels this machine cannot run.
+inline bool selectCodingKernels(const string& name) {
+    const CodingKernels* kernels = findCodingKernels(name);
+    if (!kernels) return false;
+    activeCodingKernels() = kernels;
+    return true;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              PACKED BIT READER
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * MSB-first reader over packed bytes. The next unread bit is always the top
+ * bit of 'buffer'; refill() tops it up to at least 56 bits, loading eight
+ * bytes at a time away from the end. Reads past the end see zero bits, so
+ * callers bound decoding by the logical bit length, not by the reader.
+ */
+class BitReader {
+private:
+    const unsigned char* data;
+    size_t size;
+    size_t bytePos;
+    uint64_t buffer;
+    unsigned bitCount;
+    
+public:
+    BitReader(const char* bytes, size_t length)
+        : data((const unsigned char*)bytes), size(length), bytePos(0), buffer(0), bitCount(0) {
+        refill();
+    }
+    
+    void refill() {
+        if (bytePos + 8 <= size) {
+            buffer |= loadBigEndian64(data + bytePos) >> bitCount;
+            bytePos += (63 - bitCount) >> 3;
+            bitCount |= 56;
+        } else {
+            while (bitCount <= 56) {
+                uint64_t byte = bytePos < size ? data[bytePos] : 0;
+                buffer |= byte << (56 - bitCount);
+                bytePos++;
+                bitCount += 8;
+            }
+        }
+    }
+    
+    // Returns the next 'count' bits (1..32) without consuming them
+    uint32_t peek(unsigned count) const {
+        return (uint32_t)(buffer >> (64 - count));
+    }
+    
+    void consume(unsigned count) {
+        buffer <<= count;
+        bitCount -= count;
+    }
+    
+    unsigned available() const {
+        return bitCount;
+    }
+    
+    // Bits consumed so far (may run past the data on malformed input)
+    uint64_t position() const {
+        return (uint64_t)bytePos * 8 - bitCount;
+    }
+};
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              TABLE-DRIVEN DECODER
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Multi-level lookup table. The primary table is indexed by the next
+ * kPrimaryBits bits; codes longer than that resolve through sub-tables
+ * indexed by the following bits, so a symbol costs one lookup per level
+ * instead of one pointer hop per bit.
+ */
+struct DecodeEntry {
+    uint32_t value;     // Symbol, or offset of the sub-table when subBits > 0
+    uint8_t length;     // Bits consumed at this level (0 = invalid code)
+    uint8_t subBits;    // Index width of the sub-table, 0 for symbol entries
+};
+
+class HuffmanDecodeTable {
+private:
+    static const unsigned kPrimaryBits = 11;
+    static const unsigned kSubTableBits = 8;
+    
+    struct PendingCode {
+        uint32_t symbol;
+        uint64_t bits;
+        unsigned length;
+    };
+    
+    /**
+     * Decode loops specialized at compile time on the table shape (single
+     * level or multi-level) and on PerRefill, the symbols decoded per
+     * 56-bit refill (56 / longest code), so the inner loop unrolls fully.
+     * Single-level tables decode one stream through pairLevel instead.
+     * build() picks the instantiation for the table's longest code.
+     */
+    struct DecodeKernels {
+        bool (HuffmanDecodeTable::*symbols)(const char*, size_t, uint64_t, char*, size_t) const;
+        bool (HuffmanDecodeTable::*interleaved)(const char* const[4], const size_t[4], const uint64_t[4],
+                                                char* const[4], const size_t[4]) const;
+        size_t (HuffmanDecodeTable::*lenient)(const char*, size_t, uint64_t, char*) const;
+    };
+    
+    vector<DecodeEntry> entries;
+    unsigned maxLength;
+    unsigned minLength;
+    const DecodeKernels* kernels;
+    
+    // Copy of the primary level as symbol | length << 8, used when every
+    // code fits it: one 4 KB table and no sub-table test per symbol
+    vector<uint16_t> singleLevel;
+    
+    // The same index resolving up to two codes: sym | sym2 << 8 |
+    // bits << 16 | symbols << 24. Halves the peek-load-consume chain that
+    // bounds a single stream, for both single-stream decodes.
+    vector<uint32_t> pairLevel;
+    
+    void buildLevel(size_t offset, unsigned tableBits, const vector<PendingCode>& codes) {
+        vector<vector<PendingCode> > groups(1u << tableBits);
+        
+        for (size_t i = 0; i < codes.size(); i++) {
+            const PendingCode& code = codes[i];
+            if (code.length <= tableBits) {
+                unsigned fill = tableBits - code.length;
+                size_t first = (size_t)(code.bits << fill);
+                for (size_t j = 0; j < ((size_t)1 << fill); j++) {
+                    DecodeEntry& entry = entries[offset + first + j];
+                    entry.value = code.symbol;
+                    entry.length = code.length;
+                    entry.subBits = 0;
+                }
+            } else {
+                unsigned rest = code.length - tableBits;
+                PendingCode tail;
+                tail.symbol = code.symbol;
+                tail.bits = code.bits & ((1ull << rest) - 1);
+                tail.length = rest;
+                groups[(size_t)(code.bits >> rest)].push_back(tail);
+            }
+        }
+        
+        for (size_t prefix = 0; prefix < groups.size(); prefix++) {
+            if (groups[prefix].empty()) continue;
+            
+            unsigned longest = 0;
+            for (size_t i = 0; i < groups[prefix].size(); i++) {
+                longest = max(longest, groups[prefix][i].length);
+            }
+            unsigned subBits = min(longest, (unsigned)kSubTableBits);
+            
+            size_t subOffset = entries.size();
+            entries.resize(subOffset + ((size_t)1 << subBits));
+            
+            DecodeEntry& link = entries[offset + prefix];
+            link.value = (uint32_t)subOffset;
+            link.length = tableBits;
+            link.subBits = subBits;
+            
+            buildLevel(subOffset, subBits, groups[prefix]);
+        }
+    }
+    
+    // Resolves the next code. Returns the entry describing the final level;
+    // 'consumed' receives the bits used by the preceding levels.
+    const DecodeEntry& lookup(BitReader& reader, unsigned& consumed) const {
+        consumed = 0;
+        const DecodeEntry* entry = &entries[reader.peek(kPrimaryBits)];
+        while (entry->subBits) {
+            consumed += entry->length;
+            reader.consume(entry->length);
+            if (reader.available() < 32) reader.refill();
+            entry = &entries[entry->value + reader.peek(entry->subBits)];
+        }
+        return *entry;
+    }
+    
+    // A second code fits an entry when the index bits left after the first
+    // hold all of it; shifting in zeros leaves its own lookup unchanged
+    void buildPairLevel() {
+        const size_t mask = ((size_t)1 << kPrimaryBits) - 1;
+        pairLevel.resize(singleLevel.size());
+        for (size_t i = 0; i < singleLevel.size(); i++) {
+            uint16_t first = singleLevel[i];
+            unsigned length = first >> 8;
+            if (length == 0) {
+                pairLevel[i] = 0;
+                continue;
+            }
+            uint16_t second = singleLevel[(i << length) & mask];
+            unsigned total = length + (second >> 8);
+            if ((second >> 8) != 0 && total <= kPrimaryBits) {
+                pairLevel[i] = (uint32_t)(first & 0xFF) | (uint32_t)(second & 0xFF) << 8 | 
+                               (uint32_t)total << 16 | 2u << 24;
+            } else {
+                pairLevel[i] = (uint32_t)(first & 0xFF) | (uint32_t)length << 16 | 1u << 24;
+            }
+        }
+    }
+    
+    // One symbol from a reader holding at least maxLength bits. An invalid
+    // code clears 'valid' instead of branching out of the hot loop.
+    template<bool SingleLevel>
+    HUFFMAN_FORCE_INLINE char decodeSymbol(BitReader& reader, bool& valid) const {
+        if (SingleLevel) {
+            uint16_t entry = singleLevel[reader.peek(kPrimaryBits)];
+            valid &= entry > 0xFF;
+            reader.consume(entry >> 8);
+            return (char)entry;
+        }
+        unsigned consumed;
+        const DecodeEntry& entry = lookup(reader, consumed);
+        valid &= entry.length != 0;
+        reader.consume(entry.length);
+        return (char)entry.value;
+    }
+    
+    // For the lenient decode: an invalid code skips one bit and writes
+    // nothing, without a branch
+    template<bool SingleLevel>
+    HUFFMAN_FORCE_INLINE size_t decodeOrSkip(BitReader& reader, char* out) const {
+        unsigned length;
+        char symbol;
+        if (SingleLevel) {
+            uint16_t entry = singleLevel[reader.peek(kPrimaryBits)];
+            length = entry >> 8;
+            symbol = (char)entry;
+        } else {
+            unsigned consumed;
+            const DecodeEntry& entry = lookup(reader, consumed);
+            length = entry.length;
+            symbol = (char)entry.value;
+        }
+        reader.consume(length + (length == 0));
+        *out = symbol;
+        return length != 0;
+    }
+    
+    template<bool SingleLevel, unsigned PerRefill>
+    bool decodeSymbolsWith(const char* bytes, size_t size, uint64_t bitLength, 
+                           char* out, size_t count) const {
+        BitReader reader(bytes, size);
+        bool valid = true;
+        size_t i = 0;
+        while (i + PerRefill <= count) {
+            reader.refill();
+            for (unsigned k = 0; k < PerRefill; k++) {
+                out[i + k] = decodeSymbol<SingleLevel>(reader, valid);
+            }
+            i += PerRefill;
+        }
+        reader.refill();
+        for (; i < count; i++) {
+            out[i] = decodeSymbol<false>(reader, valid);
+        }
+        
+        return valid && reader.position() <= bitLength;
+    }
+    
+    template<bool SingleLevel, unsigned PerRefill>
+    bool decodeInterleavedWith(const char* const bytes[4], const size_t sizes[4], 
+                               const uint64_t bitLengths[4], char* const out[4],
+                               const size_t counts[4]) const {
+        BitReader r0(bytes[0], sizes[0]);
+        BitReader r1(bytes[1], sizes[1]);
+        BitReader r2(bytes[2], sizes[2]);
+        BitReader r3(bytes[3], sizes[3]);
+        char* o0 = out[0];
+        char* o1 = out[1];
+        char* o2 = out[2];
+        char* o3 = out[3];
+        
+        bool valid = true;
+        size_t common = min(min(counts[0], counts[1]), min(counts[2], counts[3]));
+        size_t i = 0;
+        while (i + PerRefill <= common) {
+            r0.refill();
+            r1.refill();
+            r2.refill();
+            r3.refill();
+            for (unsigned k = 0; k < PerRefill; k++) {
+                o0[i + k] = decodeSymbol<SingleLevel>(r0, valid);
+                o1[i + k] = decodeSymbol<SingleLevel>(r1, valid);
+                o2[i + k] = decodeSymbol<SingleLevel>(r2, valid);
+                o3[i + k] = decodeSymbol<SingleLevel>(r3, valid);
+            }
+            i += PerRefill;
+        }
+        
+        BitReader* readers[4] = { &r0, &r1, &r2, &r3 };
+        for (int s = 0; s < 4; s++) {
+            BitReader& reader = *readers[s];
+            for (size_t j = i; j < counts[s]; j++) {
+                if (reader.available() < 32) reader.refill();
+                out[s][j] = decodeSymbol<false>(reader, valid);
+            }
+            if (reader.position() > bitLengths[s]) valid = false;
+        }
+        return valid;
+    }
+    
+    // Body of decode(): writes every complete code of the first bitLength
+    // bits to 'out' (room for bitLength / minLength + 64 symbols) and
+    // returns the count
+    template<bool SingleLevel, unsigned PerRefill>
+    size_t decodeLenientWith(const char* bytes, size_t size, uint64_t bitLength, char* out) const {
+        BitReader reader(bytes, size);
+        size_t n = 0;
+        
+        // A whole batch while it cannot run past the end
+        while (bitLength - reader.position() >= 64) {
+            reader.refill();
+            for (unsigned k = 0; k < PerRefill; k++) {
+                n += decodeOrSkip<SingleLevel>(reader, out + n);
+            }
+        }
+        return n + decodeLenientTail(reader, bitLength, out + n);
+    }
+    
+    // Each step resolves one or two codes totalling at most kPrimaryBits,
+    // so Steps = 56 / kPrimaryBits fit a refill
+    template<unsigned Steps>
+    bool decodeSymbolsPaired(const char* bytes, size_t size, uint64_t bitLength, 
+                             char* out, size_t count) const {
+        BitReader reader(bytes, size);
+        bool valid = true;
+        size_t i = 0;
+        while (i + 2 * Steps <= count) {
+            reader.refill();
+            for (unsigned k = 0; k < Steps; k++) {
+                uint32_t entry = pairLevel[reader.peek(kPrimaryBits)];
+                unsigned symbols = entry >> 24;
+                valid &= symbols != 0;
+                out[i] = (char)entry;
+                out[i + 1] = (char)(entry >> 8);
+                reader.consume((entry >> 16) & 0xFF);
+                i += symbols + (symbols == 0);
+            }
+        }
+        for (; i < count; i++) {
+            if (reader.available() < 32) reader.refill();
+            out[i] = decodeSymbol<true>(reader, valid);
+        }
+        
+        return valid && reader.position() <= bitLength;
+    }
+    
+    template<unsigned Steps>
+    size_t decodeLenientPaired(const char* bytes, size_t size, uint64_t bitLength, char* out) const {
+        BitReader reader(bytes, size);
+        size_t n = 0;
+        while (bitLength - reader.position() >= 64) {
+            reader.refill();
+            for (unsigned k = 0; k < Steps; k++) {
+                uint32_t entry = pairLevel[reader.peek(kPrimaryBits)];
+                unsigned length = (entry >> 16) & 0xFF;
+                out[n] = (char)entry;
+                out[n + 1] = (char)(entry >> 8);
+                reader.consume(length + (length == 0));
+                n += entry >> 24;
+            }
+        }
+        return n + decodeLenientTail(reader, bitLength, out + n);
+    }
+    
+    size_t decodeLenientTail(BitReader& reader, uint64_t bitLength, char* out) const {
+        size_t n = 0;
+        while (reader.position() < bitLength) {
+            reader.refill();
+            uint64_t position = reader.position();
+            unsigned consumed;
+            const DecodeEntry& entry = lookup(reader, consumed);
+            unsigned length = entry.length == 0 ? 1 : entry.length;
+            if (position + consumed + length > bitLength) break;
+            
+            reader.consume(length);
+            if (entry.length != 0) out[n++] = (char)entry.value;
+        }
+        return n;
+    }
+    
+    static const DecodeKernels& kernelsFor(unsigned maxLength, bool singleLevel) {
+        #define HUFFMAN_DECODE_KERNELS(single, perRefill) { \
+            &HuffmanDecodeTable::decodeSymbolsWith<single, perRefill>, \
+            &HuffmanDecodeTable::decodeInterleavedWith<single, perRefill>, \
+            &HuffmanDecodeTable::decodeLenientWith<single, perRefill> }
+        #define HUFFMAN_PAIRED_KERNELS(perRefill) { \
+            &HuffmanDecodeTable::decodeSymbolsPaired<56 / kPrimaryBits>, \
+            &HuffmanDecodeTable::decodeInterleavedWith<true, perRefill>, \
+            &HuffmanDecodeTable::decodeLenientPaired<56 / kPrimaryBits> }
+        static const DecodeKernels kernels[] = {
+            HUFFMAN_PAIRED_KERNELS(8),              // longest code <= 7
+            HUFFMAN_PAIRED_KERNELS(7),              // 8
+            HUFFMAN_PAIRED_KERNELS(6),              // 9
+            HUFFMAN_PAIRED_KERNELS(5),              // 10, 11
+            HUFFMAN_DECODE_KERNELS(false, 4),       // <= 14
+            HUFFMAN_DECODE_KERNELS(false, 3),       // <= 18
+            HUFFMAN_DECODE_KERNELS(false, 2),       // <= 28
+            HUFFMAN_DECODE_KERNELS(false, 1)        // <= 32
+        };
+        #undef HUFFMAN_DECODE_KERNELS
+        #undef HUFFMAN_PAIRED_KERNELS
+        
+        if (singleLevel) {
+            return kernels[maxLength <= 7 ? 0 : maxLength <= 8 ? 1 : maxLength <= 9 ? 2 : 3];
+        }
+        return kernels[maxLength <= 14 ? 4 : maxLength <= 18 ? 5 : maxLength <= 28 ? 6 : 7];
+    }
+    
+public:
+    HuffmanDecodeTable() : maxLength(0), minLength(0), kernels(nullptr) {}
+    
+    // codes is indexed by symbol; len == 0 means unused. Alphabets larger
+    // than a byte (code-point coding) decode through decodeValues() only.
+    void build(const HuffmanCode* codes, size_t symbolCount) {
+        vector<PendingCode> pending;
+        maxLength = 0;
+        minLength = kMaxCodeLength;
+        for (size_t i = 0; i < symbolCount; i++) {
+            if (codes[i].len == 0) continue;
+            PendingCode code;
+            code.symbol = (uint32_t)i;
+            code.bits = codes[i].bits;
+            code.length = codes[i].len;
+            pending.push_back(code);
+            maxLength = max(maxLength, code.length);
+            minLength = min(minLength, code.length);
+        }
+        
+        entries.assign((size_t)1 << kPrimaryBits, DecodeEntry());
+        buildLevel(0, kPrimaryBits, pending);
+        
+        singleLevel.clear();
+        pairLevel.clear();
+        if (maxLength <= kPrimaryBits && symbolCount <= 256) {
+            singleLevel.resize(entries.size());
+            for (size_t i = 0; i < singleLevel.size(); i++) {
+                singleLevel[i] = (uint16_t)(entries[i].length << 8 | (entries[i].value & 0xFF));
+            }
+            buildPairLevel();
+        }
+        kernels = &kernelsFor(maxLength, !singleLevel.empty());
+    }
+    
+    void clear() {
+        entries.clear();
+        singleLevel.clear();
+        pairLevel.clear();
+        maxLength = 0;
+        minLength = 0;
+        kernels = nullptr;
+    }
+    
+    bool empty() const {
+        return entries.empty();
+    }
+    
+    // Decodes exactly 'count' symbols into 'out'. Returns false if the
+    // stream holds an invalid code or needs more than bitLength bits.
+    bool decodeSymbols(const char* bytes, size_t size, uint64_t bitLength, 
+                       char* out, size_t count) const {
+        if (count == 0) return true;
+        if (entries.empty() || maxLength == 0) return false;
+        return (this->*kernels->symbols)(bytes, size, bitLength, out, count);
+    }
+    
+    // Four independent streams decoded in lockstep, so four table lookups
+    // are in flight at once instead of one dependent chain
+    bool decodeInterleaved(const char* const bytes[4], const size_t sizes[4], 
+                           const uint64_t bitLengths[4], char* const out[4],
+                           const size_t counts[4]) const {
+        if (entries.empty() || maxLength == 0) {
+            return counts[0] + counts[1] + counts[2] + counts[3] == 0;
+        }
+        return (this->*kernels->interleaved)(bytes, sizes, bitLengths, out, counts);
+    }
+    
+    // Appends the symbol of every code in exactly the first bitLength bits.
+    // Returns false on an invalid code or one running past bitLength.
+    bool decodeValues(const char* bytes, size_t size, uint64_t bitLength, 
+                      vector<uint32_t>& values) const {
+        if (bitLength > (uint64_t)size * 8) return false;
+        if (bitLength == 0) return true;
+        if (entries.empty()) return false;
+        
+        BitReader reader(bytes, size);
+        uint64_t position = 0;
+        while (position < bitLength) {
+            if (reader.available() < 32) reader.refill();
+            unsigned consumed;
+            const DecodeEntry& entry = lookup(reader, consumed);
+            if (entry.length == 0) return false;
+            reader.consume(entry.length);
+            position += consumed + entry.length;
+            if (position > bitLength) return false;
+            values.push_back(entry.value);
+        }
+        return true;
+    }
+    
+    // Decodes every complete code in the first bitLength bits of 'bytes'.
+    // Invalid bit patterns are skipped one bit at a time.
+    string decode(const char* bytes, size_t size, uint64_t bitLength) const {
+        string decoded;
+        if (entries.empty() || maxLength == 0) return decoded;
+        
+        bitLength = min(bitLength, (uint64_t)size * 8);
+        decoded.resize((size_t)(bitLength / minLength) + 64);
+        decoded.resize((this->*kernels->lenient)(bytes, size, bitLength, &decoded[0]));
+        return decoded;
+    }
+};
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              BYTE HISTOGRAM
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Counts into four interleaved tables so that runs of the same byte do
+// not serialize on a single counter's store-to-load dependency
+static void countFrequencies(const char* bytes, size_t length, uint32_t counts[256]) {
+    uint32_t lanes[4][256];
+    memset(lanes, 0, sizeof(lanes));
+    
+    const unsigned char* data = (const unsigned char*)bytes;
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4) {
+        lanes[0][data[i]]++;
+        lanes[1][data[i + 1]]++;
+        lanes[2][data[i + 2]]++;
+        lanes[3][data[i + 3]]++;
+    }
+    for (; i < length; i++) {
+        lanes[0][data[i]]++;
+    }
+    
+    for (int symbol = 0; symbol < 256; symbol++) {
+        counts[symbol] = lanes[0][symbol] + lanes[1][symbol] + lanes[2][symbol] + lanes[3][symbol];
+    }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              CHECKSUM
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * CRC32C (Castagnoli), the block checksum of frames and streams. With
+ * SSE4.2 the CRC32 instruction folds in 8 bytes per step; elsewhere a
+ * slicing-by-8 table does. crc32c(b, n, crc32c(a, m)) is the checksum of
+ * a followed by b, so output can be checked piece by piece as it is
+ * produced.
+ */
+static const uint32_t kCrc32cPolynomial = 0x82F63B78;   // Bit-reflected
+
+struct Crc32cTables {
+    uint32_t table[8][256];
+    
+    Crc32cTables() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (kCrc32cPolynomial & (0u - (crc & 1)));
+            }
+            table[0][i] = crc;
+        }
+        for (int t = 1; t < 8; t++) {
+            for (uint32_t i = 0; i < 256; i++) {
+                table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+// Works on the inverted register; crc32c() does the inversions
+typedef uint32_t (*ChecksumKernel)(uint32_t crc, const unsigned char* data, size_t length);
+
+static uint32_t crc32cTable(uint32_t crc, const unsigned char* data, size_t length) {
+    static const Crc32cTables tables;
+    const uint32_t (*t)[256] = tables.table;
+    for (; length >= 8; data += 8, length -= 8) {
+        uint32_t low = crc ^ (data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24);
+        uint32_t high = data[4] | data[5] << 8 | data[6] << 16 | (uint32_t)data[7] << 24;
+        crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+              t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+    }
+    for (; length > 0; data++, length--) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xFF];
+    }
+    return crc;
+}
+
+#ifdef HUFFMAN_HAVE_CRC32C_KERNEL
+static const size_t kCrc32cLane = 4096;
+
+// The register after kCrc32cLane zero bytes. That map is linear, so four
+// byte tables built from the images of the 32 single-bit registers apply it.
+struct Crc32cLaneShift {
+    uint32_t table[4][256];
+    
+    Crc32cLaneShift() {
+        static const unsigned char zeros[kCrc32cLane] = {0};
+        uint32_t columns[32];
+        for (int bit = 0; bit < 32; bit++) {
+            columns[bit] = crc32cTable(1u << bit, zeros, kCrc32cLane);
+        }
+        for (int k = 0; k < 4; k++) {
+            for (uint32_t b = 0; b < 256; b++) {
+                uint32_t image = 0;
+                for (int bit = 0; bit < 8; bit++) {
+                    if (b & (1u << bit)) image ^= columns[8 * k + bit];
+                }
+                table[k][b] = image;
+            }
+        }
+    }
+    
+    uint32_t apply(uint32_t crc) const {
+        return table[0][crc & 0xFF] ^ table[1][(crc >> 8) & 0xFF] ^ 
+               table[2][(crc >> 16) & 0xFF] ^ table[3][crc >> 24];
+    }
+};
+
+// CRC32 has a 3-cycle latency and 1-cycle throughput, so three lanes of
+// kCrc32cLane bytes run side by side and are then shifted into one
+HUFFMAN_TARGET_SSE42
+static uint32_t crc32cSse42(uint32_t crc, const unsigned char* data, size_t length) {
+    static const Crc32cLaneShift shift;
+    for (; length >= 3 * kCrc32cLane; data += 3 * kCrc32cLane, length -= 3 * kCrc32cLane) {
+        uint64_t a = crc;
+        uint64_t b = 0;
+        uint64_t c = 0;
+        for (size_t i = 0; i < kCrc32cLane; i += 8) {
+            uint64_t words[3];
+            memcpy(&words[0], data + i, 8);
+            memcpy(&words[1], data + kCrc32cLane + i, 8);
+            memcpy(&words[2], data + 2 * kCrc32cLane + i, 8);
+            a = _mm_crc32_u64(a, words[0]);
+            b = _mm_crc32_u64(b, words[1]);
+            c = _mm_crc32_u64(c, words[2]);
+        }
+        crc = shift.apply(shift.apply((uint32_t)a) ^ (uint32_t)b) ^ (uint32_t)c;
+    }
+    
+    uint64_t value = crc;
+    for (; length >= 8; data += 8, length -= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        value = _mm_crc32_u64(value, word);
+    }
+    crc = (uint32_t)value;
+    for (; length > 0; data++, length--) {
+        crc = _mm_crc32_u8(crc, *data);
+    }
+    return crc;
+}
+#endif
+
+struct ChecksumKernels {
+    const char* name;
+    ChecksumKernel crc32c;
+};
+
+// Picked from the CPU on first use
+inline const ChecksumKernels& checksumKernels() {
+    static const ChecksumKernels table = { "table", crc32cTable };
+#ifdef HUFFMAN_HAVE_CRC32C_KERNEL
+    static const ChecksumKernels sse42 = { "sse4.2", crc32cSse42 };
+    static const bool hardware = (__builtin_cpu_init(), __builtin_cpu_supports("sse4.2") != 0);
+    if (hardware) return sse42;
+#endif
+    return table;
+}
+
+// CRC32C of data[0..length), continuing from the checksum of what came before
+inline uint32_t crc32c(const char* data, size_t length, uint32_t crc = 0) {
+    return ~checksumKernels().crc32c(~crc, (const unsigned char*)data, length);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              CODE LENGTH CONSTRUCTION
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * In-place minimum-redundancy code lengths (Moffat & Katajainen, 1995).
+ * On entry 'weights' holds the n leaf weights sorted ascending; on return
+ * weights[i] is the code length of the i-th leaf. This is the two-queue
+ * merge with both queues kept inside the array: no heap, no tree, O(n)
+ * after the sort. Ties prefer the leaf queue, which also keeps the deepest
+ * code as short as possible, so equal inputs always give equal lengths.
+ */
+static void computeCodeLengthsInPlace(uint64_t* weights, size_t n) {
+    if (n == 0) return;
+    if (n == 1) {
+        weights[0] = 1;
+        return;
+    }
+    
+    // First pass, left to right: merge, leaving parent pointers behind
+    size_t root = 0;
+    size_t leaf = 2;
+    weights[0] += weights[1];
+    for (size_t next = 1; next < n - 1; next++) {
+        if (leaf >= n || weights[root] < weights[leaf]) {
+            weights[next] = weights[root];
+            weights[root++] = next;
+        } else {
+            weights[next] = weights[leaf++];
+        }
+        
+        if (leaf >= n || (root < next && weights[root] < weights[leaf])) {
+            weights[next] += weights[root];
+            weights[root++] = next;
+        } else {
+            weights[next] += weights[leaf++];
+        }
+    }
+    
+    // Second pass, right to left: internal node depths
+    weights[n - 2] = 0;
+    for (size_t next = n - 2; next-- > 0; ) {
+        weights[next] = weights[weights[next]] + 1;
+    }
+    
+    // Third pass, right to left: leaf depths
+    int64_t available = 1;
+    int64_t used = 0;
+    uint64_t depth = 0;
+    int64_t internal = (int64_t)n - 2;
+    int64_t next = (int64_t)n - 1;
+    while (available > 0) {
+        while (internal >= 0 && weights[internal] == depth) {
+            used++;
+            internal--;
+        }
+        while (available > used) {
+            weights[next--] = depth;
+            available--;
+        }
+        available = 2 * used;
+        depth++;
+        used = 0;
+    }
+}
+
+/**
+ * Optimal code lengths no longer than maxLength, by package-merge (Larmore &
+ * Hirschberg, 1990). 'weights' are the n >= 2 leaf weights sorted ascending
+ * and 2^maxLength must be at least n; lengths[i] receives the i-th length.
+ *
+ * Level maxLength starts as the leaves; each shallower level merges the
+ * leaves with pairs ("packages") of the level below, keeping the lightest
+ * 2n - 2 items. Taking the first 2n - 2 items of level 1 and following the
+ * packages back down, a leaf's code length is the number of levels at which
+ * it was taken. Since every level is a sorted merge, only the number of
+ * leaves among each level's first k items has to be remembered.
+ */
+static void computeLimitedCodeLengths(const uint64_t* weights, size_t n, 
+                                      unsigned maxLength, unsigned* lengths) {
+    size_t keep = 2 * n - 2;
+    vector<vector<uint32_t> > leavesBefore(maxLength + 1);
+    vector<uint64_t> below;
+    vector<uint64_t> level;
+    
+    for (unsigned depth = maxLength; depth >= 1; depth--) {
+        level.clear();
+        vector<uint32_t>& leafCount = leavesBefore[depth];
+        leafCount.assign(1, 0);
+        
+        size_t leaf = 0;
+        size_t package = 0;
+        size_t packages = below.size() / 2;
+        while (level.size() < keep && (leaf < n || package < packages)) {
+            uint64_t packageWeight = package < packages 
+                ? below[2 * package] + below[2 * package + 1] : 0;
+            if (leaf < n && (package >= packages || weights[leaf] <= packageWeight)) {
+                level.push_back(weights[leaf++]);
+            } else {
+                level.push_back(packageWeight);
+                package++;
+            }
+            leafCount.push_back((uint32_t)leaf);
+        }
+        below.swap(level);
+    }
+    
+    for (size_t i = 0; i < n; i++) lengths[i] = 0;
+    
+    size_t taken = keep;
+    for (unsigned depth = 1; depth <= maxLength && taken > 0; depth++) {
+        size_t leaves = leavesBefore[depth][taken];
+        for (size_t i = 0; i < leaves; i++) lengths[i]++;
+        taken = 2 * (taken - leaves);
+    }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              UTF-8
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Length (1-4) of the well-formed UTF-8 sequence at p, or 0 if there is
+// none: overlong forms, surrogates and code points above U+10FFFF are
+// rejected as RFC 3629 requires
+static inline size_t utf8SequenceLength(const unsigned char* p, size_t available) {
+    unsigned char c = p[0];
+    if (c < 0x80) return 1;
+    if (c < 0xC2 || c > 0xF4) return 0;
+    
+    size_t length = c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+    if (available < length) return 0;
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+    if (c == 0xE0) low = 0xA0;
+    else if (c == 0xED) high = 0x9F;
+    else if (c == 0xF0) low = 0x90;
+    else if (c == 0xF4) high = 0x8F;
+    if (p[1] < low || p[1] > high) return 0;
+    for (size_t i = 2; i < length; i++) {
+        if ((p[i] & 0xC0) != 0x80) return 0;
+    }
+    return length;
+}
+
+// Code point of a sequence utf8SequenceLength() accepted
+static inline uint32_t utf8CodePoint(const unsigned char* p, size_t length) {
+    static const unsigned char leadMask[5] = { 0, 0x7F, 0x1F, 0x0F, 0x07 };
+    uint32_t codePoint = p[0] & leadMask[length];
+    for (size_t i = 1; i < length; i++) {
+        codePoint = (codePoint << 6) | (p[i] & 0x3F);
+    }
+    return codePoint;
+}
+
+static inline void appendUtf8(string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        out += (char)codePoint;
+    } else if (codePoint < 0x800) {
+        out += (char)(0xC0 | (codePoint >> 6));
+        out += (char)(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        out += (char)(0xE0 | (codePoint >> 12));
+        out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        out += (char)(0x80 | (codePoint & 0x3F));
+    } else {
+        out += (char)(0xF0 | (codePoint >> 18));
+        out += (char)(0x80 | ((codePoint >> 12) & 0x3F));
+        out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        out += (char)(0x80 | (codePoint & 0x3F));
+    }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              JSON WRITER
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * All JSON output goes through JsonWriter, which appends into one string
+ * reserved up front. Commas are placed automatically: a key or an array
+ * element after a completed value is preceded by one.
+ *
+ * String escaping copies runs of safe bytes in bulk. kJsonEscape maps each
+ * byte to 0 (copy as is), the letter of its short escape ('n' for \n),
+ * 'u' for \u00XX or 'x' for the lead of a multi-byte sequence. With SSE2
+ * the scan for '"', '\\', control characters and non-ASCII bytes looks at
+ * 16 bytes at a time.
+ *
+ * The output is always valid UTF-8: well-formed sequences are copied and
+ * any other byte b >= 0x80 becomes \u00XX, i.e. the character whose code
+ * is b. Byte-valued strings (symbols, tree labels) therefore read back in
+ * JavaScript with charCodeAt() equal to the byte.
+ */
+static const char kJsonEscape[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',
+    'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',
+    'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',
+    'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',
+    'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',
+    'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',
+    'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',
+    'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',
+};
+
+// Length of the prefix of data that needs no escaping
+static size_t safeJsonRun(const char* data, size_t length) {
+    size_t i = 0;
+#ifdef HUFFMAN_HAVE_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+            _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));       // v <= 0x1F
+        int mask = _mm_movemask_epi8(special) | _mm_movemask_epi8(v);     // | bytes >= 0x80
+        if (mask != 0) {
+#ifdef _MSC_VER
+            unsigned long first;
+            _BitScanForward(&first, (unsigned long)mask);
+            return i + first;
+#else
+            return i + __builtin_ctz((unsigned)mask);
+#endif
+        }
+    }
+#endif
+    while (i < length && kJsonEscape[(unsigned char)data[i]] == 0) i++;
+    return i;
+}
+
+inline void appendJsonEscaped(string& out, const char* data, size_t length) {
+    static const char hexDigits[] = "0123456789abcdef";
+    size_t i = 0;
+    while (i < length) {
+        size_t run = safeJsonRun(data + i, length - i);
+        out.append(data + i, run);
+        i += run;
+        if (i == length) break;
+        
+        unsigned char c = (unsigned char)data[i];
+        char escape = kJsonEscape[c];
+        if (escape == 'x') {
+            size_t sequence = utf8SequenceLength((const unsigned char*)data + i, length - i);
+            if (sequence > 0) {
+                out.append(data + i, sequence);
+                i += sequence;
+                continue;
+            }
+            escape = 'u';
+        }
+        i++;
+        char buffer[6] = { '\\', escape, '0', '0', hexDigits[c >> 4], hexDigits[c & 15] };
+        out.append(buffer, escape == 'u' ? 6 : 2);
+    }
+}
+
+class JsonWriter {
+private:
+    string out;
+    bool needComma;
+    
+    void separate() {
+        if (needComma) out += ',';
+        needComma = false;
+    }
+    
+public:
+    explicit JsonWriter(size_t reserve = 256) : needComma(false) {
+        out.reserve(reserve);
+    }
+    
+    JsonWriter& beginObject() { separate(); out += '{'; return *this; }
+    JsonWriter& endObject() { out += '}'; needComma = true; return *this; }
+    JsonWriter& beginArray() { separate(); out += '['; return *this; }
+    JsonWriter& endArray() { out += ']'; needComma = true; return *this; }
+    
+    JsonWriter& key(const char* name, size_t length) {
+        separate();
+        out += '"';
+        appendJsonEscaped(out, name, length);
+        out += "\":";
+        return *this;
+    }
+    
+    JsonWriter& key(const char* name) {
+        return key(name, strlen(name));
+    }
+    
+    JsonWriter& key(const string& name) {
+        return key(name.data(), name.length());
+    }
+    
+    JsonWriter& value(const char* data, size_t length) {
+        separate();
+        out += '"';
+        appendJsonEscaped(out, data, length);
+        out += '"';
+        needComma = true;
+        return *this;
+    }
+    
+    JsonWriter& value(const string& text) {
+        return value(text.data(), text.length());
+    }
+    
+    JsonWriter& value(const char* text) {
+        return value(text, strlen(text));
+    }
+    
+    JsonWriter& value(uint64_t number) {
+        char digits[20];
+        size_t count = 0;
+        do {
+            digits[count++] = (char)('0' + number % 10);
+            number /= 10;
+        } while (number != 0);
+        separate();
+        while (count > 0) out += digits[--count];
+        needComma = true;
+        return *this;
+    }
+    
+    JsonWriter& value(double number, int precision) {
+        char buffer[32];
+        int length = snprintf(buffer, sizeof(buffer), "%.*f", precision, number);
+        separate();
+        out.append(buffer, length > 0 ? (size_t)length : 0);
+        needComma = true;
+        return *this;
+    }
+    
+    JsonWriter& boolean(bool flag) {
+        separate();
+        out += flag ? "true" : "false";
+        needComma = true;
+        return *this;
+    }
+    
+    JsonWriter& null() {
+        separate();
+        out += "null";
+        needComma = true;
+        return *this;
+    }
+    
+    string& str() {
+        return out;
+    }
+};
+
+// Helper function to escape string for JSON
+inline string escapeJsonString(const string& input) {
+    string out;
+    out.reserve(input.length() + 16);
+    appendJsonEscaped(out, input.data(), input.length());
+    return out;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              HUFFMAN CODER CLASS
+// ═══════════════════════════════════════════════════════════════════════════════
+
+inline string codeToString(const HuffmanCode& code) {
+    string bits(code.len, '0');
+    for (unsigned j = 0; j < code.len; j++) {
+        if ((code.bits >> (code.len - 1 - j)) & 1) bits[j] = '1';
+    }
+    return bits;
+}
+
+// '0'/'1' form of the first bitLength bits of packed (MSB-first) bytes
+inline string packedToBitString(const string& packed, uint64_t bitLength) {
+    string encoded((size_t)bitLength, '0');
+    for (size_t i = 0; i < encoded.length(); i++) {
+        if (((unsigned char)packed[i >> 3] >> (7 - (i & 7))) & 1) encoded[i] = '1';
+    }
+    return encoded;
+}
+
+// Packs a '0'/'1' string, ignoring other characters; returns the bit count
+inline uint64_t bitStringToPacked(const string& encoded, string& packed) {
+    packed.reserve(packed.size() + encoded.length() / 8 + 1);
+    BitWriter writer(packed);
+    for (size_t i = 0; i < encoded.length(); i++) {
+        if (encoded[i] == '0' || encoded[i] == '1') {
+            writer.write(encoded[i] == '1' ? 1 : 0, 1);
+        }
+    }
+    writer.flush();
+    return writer.getTotalBits();
+}
+
+class HuffmanCoder {
+private:
+    HuffmanTree tree;
+    array<HuffmanCode, 256> huffmanCodes;
+    array<uint64_t, 256> encodeTable;       // makeEncodeEntry() of each code
+    unsigned longestCode;
+    array<uint32_t, 256> frequencies;
+    HuffmanDecodeTable decodeTable;
+    
+    // Canonical assignment: codes are handed out in order of (length, byte
+    // value), each one the previous code plus one, shifted to its length.
+    // The tree is rebuilt from the result so that writeTree() matches.
+    void assignCanonicalCodes(const unsigned codeLengths[256]) {
+        vector<int> order;
+        for (int i = 0; i < 256; i++) {
+            if (codeLengths[i] > 0) order.push_back(i);
+        }
+        stable_sort(order.begin(), order.end(), 
+                    [&](int a, int b) { return codeLengths[a] < codeLengths[b]; });
+        
+        huffmanCodes.fill(HuffmanCode());
+        uint64_t code = 0;
+        unsigned previousLength = order.empty() ? 0 : codeLengths[order[0]];
+        for (size_t i = 0; i < order.size(); i++) {
+            unsigned length = codeLengths[order[i]];
+            code <<= (length - previousLength);
+            previousLength = length;
+            
+            huffmanCodes[order[i]].bits = (uint32_t)code;
+            huffmanCodes[order[i]].len = (uint8_t)length;
+            code++;
+        }
+        
+        longestCode = previousLength;
+        for (int symbol = 0; symbol < 256; symbol++) {
+            encodeTable[symbol] = makeEncodeEntry(huffmanCodes[symbol].bits, huffmanCodes[symbol].len);
+        }
+        rebuildTreeFromCodes();
+        decodeTable.build(huffmanCodes.data(), huffmanCodes.size());
+    }
+    
+    // Codes are complete (or a single symbol), so this needs at most 511 nodes
+    void rebuildTreeFromCodes() {
+        tree.clear();
+        if (getUniqueChars() == 0) return;
+        
+        tree.setRoot(tree.addNode(0, 0));
+        for (int symbol = 0; symbol < 256; symbol++) {
+            const HuffmanCode& code = huffmanCodes[symbol];
+            if (code.len == 0) continue;
+            
+            uint16_t index = tree.root();
+            tree[index].freq += frequencies[symbol];
+            for (int bit = code.len - 1; bit >= 0; bit--) {
+                bool right = (code.bits >> bit) & 1;
+                uint16_t child = right ? tree[index].right : tree[index].left;
+                if (child == kNullNode) {
+                    child = tree.addNode(0, 0);
+                    if (right) tree[index].right = child;
+                    else tree[index].left = child;
+                }
+                index = child;
+                tree[index].freq += frequencies[symbol];
+            }
+            tree[index].symbol = (uint8_t)symbol;
+        }
+    }
+    
+    // Display label of a tree leaf: escapes are shown as text ("\\n") and
+    // the space as "[space]", which is what the web app renders
+    static string treeLabel(unsigned char c) {
+        switch (c) {
+            case ' ':  return "[space]";
+            case '\n': return "\\n";
+            case '\t': return "\\t";
+            case '\r': return "\\r";
+            case '\b': return "\\b";
+            case '\f': return "\\f";
+        }
+        if (c < 32) {
+            static const char hexDigits[] = "0123456789abcdef";
+            char label[6] = { '\\', 'u', '0', '0', hexDigits[c >> 4], hexDigits[c & 15] };
+            return string(label, 6);
+        }
+        return string(1, (char)c);
+    }
+    
+    void writeTreeNode(JsonWriter& json, uint16_t index) const {
+        if (index == kNullNode) {
+            json.null();
+            return;
+        }
+        
+        const HuffmanNode& node = tree[index];
+        json.beginObject();
+        json.key("freq").value((uint64_t)node.freq);
+        if (node.isLeaf()) {
+            json.key("char").value(treeLabel(node.symbol));
+        } else {
+            json.key("left");
+            writeTreeNode(json, node.left);
+            json.key("right");
+            writeTreeNode(json, node.right);
+        }
+        json.endObject();
+    }
+    
+public:
+    HuffmanCoder() : longestCode(0) {
+        huffmanCodes.fill(HuffmanCode());
+        encodeTable.fill(0);
+        frequencies.fill(0);
+    }
+    
+    void reset() {
+        tree.clear();
+        huffmanCodes.fill(HuffmanCode());
+        encodeTable.fill(0);
+        longestCode = 0;
+        frequencies.fill(0);
+        decodeTable.clear();
+    }
+    
+    void calculateFrequencies(const string& text) {
+        countFrequencies(text.data(), text.length(), frequencies.data());
+    }
+    
+    // Any bytes: the alphabet is all 256 values, text or not
+    void calculateFrequencies(const char* bytes, size_t length) {
+        countFrequencies(bytes, length, frequencies.data());
+    }
+    
+    // Installs a histogram computed elsewhere (e.g. merged from blocks)
+    void setFrequencies(const array<uint32_t, 256>& counts) {
+        frequencies = counts;
+    }
+    
+    // Sorts the leaves once by (frequency, byte value) and derives the code
+    // lengths in place; the tree is then rebuilt from the canonical codes.
+    // Codes are capped at maxCodeLength bits (raised to fit the alphabet).
+    void buildTree(unsigned maxCodeLength = kDefaultMaxCodeLength) {
+        uint8_t symbols[256];
+        size_t count = 0;
+        for (int symbol = 0; symbol < 256; symbol++) {
+            if (frequencies[symbol] > 0) symbols[count++] = (uint8_t)symbol;
+        }
+        sort(symbols, symbols + count, [&](uint8_t a, uint8_t b) {
+            return frequencies[a] != frequencies[b] ? frequencies[a] < frequencies[b] : a < b;
+        });
+        
+        maxCodeLength = min(max(maxCodeLength, 1u), kMaxCodeLength);
+        while (((size_t)1 << maxCodeLength) < count) maxCodeLength++;
+        
+        uint64_t weights[256];
+        for (size_t i = 0; i < count; i++) {
+            weights[i] = frequencies[symbols[i]];
+        }
+        computeCodeLengthsInPlace(weights, count);
+        
+        // Lengths come out non-increasing, so the first leaf is the deepest
+        unsigned codeLengths[256] = {0};
+        if (count > 0 && weights[0] > maxCodeLength) {
+            uint64_t sorted[256];
+            unsigned limited[256];
+            for (size_t i = 0; i < count; i++) {
+                sorted[i] = frequencies[symbols[i]];
+            }
+            computeLimitedCodeLengths(sorted, count, maxCodeLength, limited);
+            for (size_t i = 0; i < count; i++) {
+                codeLengths[symbols[i]] = limited[i];
+            }
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                codeLengths[symbols[i]] = (unsigned)weights[i];
+            }
+        }
+        assignCanonicalCodes(codeLengths);
+    }
+    
+    // Serializes the 256 code lengths (the canonical code header):
+    //   0x00-0x3F  literal length for the next symbol
+    //   0x40-0x7F  previous literal repeated (b - 0x40 + 1) more times
+    //   0x80-0xFF  (b - 0x80 + 1) consecutive unused symbols
+    string getCodeLengthHeader() const {
+        string header;
+        int i = 0;
+        while (i < 256) {
+            unsigned length = huffmanCodes[i].len;
+            int run = 1;
+            if (length == 0) {
+                while (i + run < 256 && run < 128 && huffmanCodes[i + run].len == 0) run++;
+                header += (char)(0x80 + run - 1);
+            } else {
+                header += (char)length;
+                while (i + run < 256 && run < 65 && huffmanCodes[i + run].len == length) run++;
+                if (run > 1) header += (char)(0x40 + run - 2);
+            }
+            i += run;
+        }
+        return header;
+    }
+    
+    // Rebuilds the coder from a code-length header. No frequencies are known
+    // afterwards; encode/decode work, the tree carries zero weights.
+    bool loadCodeLengthHeader(const string& header) {
+        unsigned codeLengths[256] = {0};
+        int symbol = 0;
+        unsigned previous = 0;
+        for (size_t i = 0; i < header.length(); i++) {
+            unsigned char b = (unsigned char)header[i];
+            int run;
+            unsigned length;
+            if (b < 0x40) {
+                run = 1;
+                length = b;
+            } else if (b < 0x80) {
+                if (previous == 0) return false;
+                run = b - 0x40 + 1;
+                length = previous;
+            } else {
+                run = b - 0x80 + 1;
+                length = 0;
+            }
+            if (symbol + run > 256 || length > kMaxCodeLength) return false;
+            for (int j = 0; j < run; j++) {
+                codeLengths[symbol++] = length;
+            }
+            previous = length;
+        }
+        if (symbol != 256) return false;
+        
+        // Kraft equality: the lengths must describe a complete prefix code,
+        // except for the one-symbol alphabet. This also bounds the tree.
+        uint64_t kraft = 0;
+        int used = 0;
+        for (int i = 0; i < 256; i++) {
+            if (codeLengths[i] > 0) {
+                kraft += 1ull << (kMaxCodeLength - codeLengths[i]);
+                used++;
+            }
+        }
+        if (used == 0 || (used > 1 && kraft != (1ull << kMaxCodeLength))) return false;
+        
+        reset();
+        assignCanonicalCodes(codeLengths);
+        return true;
+    }
+    
+    // Encodes to a '0'/'1' string (the packed form, one character per bit)
+    string encode(const string& text) const {
+        return encode(text.data(), text.length());
+    }
+    
+    string encode(const char* bytes, size_t length) const {
+        uint64_t bitLength = 0;
+        string packed = encodePacked(bytes, length, bitLength);
+        return packedToBitString(packed, bitLength);
+    }
+    
+    // Encodes into packed bytes (MSB-first, last byte zero-padded).
+    // bitLength receives the number of meaningful bits.
+    string encodePacked(const string& text, uint64_t& bitLength) const {
+        return encodePacked(text.data(), text.length(), bitLength);
+    }
+    
+    string encodePacked(const char* bytes, size_t length, uint64_t& bitLength) const {
+        string packed;
+        bitLength = encodePacked(bytes, length, packed);
+        return packed;
+    }
+    
+    // Appends the packed code for data[0..length) to 'out' and returns the
+    // bit count. Const, so one coder can serve several threads at once.
+    uint64_t encodePacked(const char* bytes, size_t length, string& out) const {
+        if (length == 0) return 0;
+        
+        // Reserve from the average code length under this coder's histogram
+        uint64_t totalBits = 0;
+        uint64_t totalCount = 0;
+        for (int symbol = 0; symbol < 256; symbol++) {
+            totalBits += (uint64_t)frequencies[symbol] * huffmanCodes[symbol].len;
+            totalCount += frequencies[symbol];
+        }
+        uint64_t estimate = totalCount > 0 ? totalBits * length / totalCount : (uint64_t)length * 8;
+        
+        // The kernel writes straight into 'out', chunk by chunk; the buffer
+        // only grows past the estimate when the input has a different mix
+        static const size_t kChunkSize = 16384;
+        size_t chunkBound = kChunkSize * longestCode / 8 + 16;
+        size_t start = out.size();
+        size_t written = start;
+        out.resize(start + (size_t)(estimate / 8) + chunkBound);
+        
+        EncodeKernel kernel = codingKernels().encode[encodeGroupIndex(longestCode)];
+        const unsigned char* data = (const unsigned char*)bytes;
+        uint64_t pending = 0;
+        unsigned pendingBits = 0;
+        for (size_t i = 0; i < length; i += kChunkSize) {
+            size_t chunk = min(kChunkSize, length - i);
+            if (out.size() < written + chunkBound) {
+                out.resize(max(written + chunkBound, out.size() + out.size() / 2));
+            }
+            unsigned char* base = (unsigned char*)&out[0];
+            written = kernel(encodeTable.data(), data + i, chunk, base + written, pending, pendingBits) - base;
+        }
+        
+        uint64_t bitLength = (uint64_t)(written - start) * 8 + pendingBits;
+        if (pendingBits > 0) out[written++] = (char)(pending >> 56);
+        out.resize(written);
+        return bitLength;
+    }
+    
+    // Decodes a '0'/'1' string; other characters are ignored
+    string decode(const string& encoded) const {
+        if (tree.empty() || encoded.empty()) return "";
+        
+        string packed;
+        uint64_t bitLength = bitStringToPacked(encoded, packed);
+        return decodePacked(packed, bitLength);
+    }
+    
+    string decodePacked(const string& packed, uint64_t bitLength) const {
+        return decodePacked(packed.data(), packed.length(), bitLength);
+    }
+    
+    string decodePacked(const char* bytes, size_t size, uint64_t bitLength) const {
+        if (tree.empty() || size == 0) return "";
+        return decodeTable.decode(bytes, size, bitLength);
+    }
+    
+    const HuffmanDecodeTable& getDecodeTable() const {
+        return decodeTable;
+    }
+    
+    // {"<symbol>": count, ...} for the symbols that occur
+    void writeFrequencies(JsonWriter& json) const {
+        json.beginObject();
+        for (int symbol = 0; symbol < 256; symbol++) {
+            if (frequencies[symbol] == 0) continue;
+            char key = (char)symbol;
+            json.key(&key, 1).value((uint64_t)frequencies[symbol]);
+        }
+        json.endObject();
+    }
+    
+    // {"<symbol>": "0101", ...}
+    void writeCodes(JsonWriter& json) const {
+        json.beginObject();
+        for (int symbol = 0; symbol < 256; symbol++) {
+            if (huffmanCodes[symbol].len == 0) continue;
+            char key = (char)symbol;
+            json.key(&key, 1).value(codeToString(huffmanCodes[symbol]));
+        }
+        json.endObject();
+    }
+    
+    void writeTree(JsonWriter& json) const {
+        writeTreeNode(json, tree.root());
+    }
+    
+    int getOriginalBits(const string& text) const {
+        return text.length() * 8;
+    }
+    
+    int getEncodedBits(const string& encoded) const {
+        return encoded.length();
+    }
+    
+    double getCompressionRatio(const string& text, const string& encoded) const {
+        return getCompressionRatio(text, (uint64_t)getEncodedBits(encoded));
+    }
+    
+    double getCompressionRatio(const string& text, uint64_t encodedBits) const {
+        return getCompressionRatio(text.length(), encodedBits);
+    }
+    
+    double getCompressionRatio(size_t originalLength, uint64_t encodedBits) const {
+        if (originalLength == 0) return 0;
+        double original = (double)originalLength * 8;
+        return ((original - (double)encodedBits) / original) * 100;
+    }
+    
+    unsigned getCodeLength(unsigned char symbol) const {
+        return huffmanCodes[symbol].len;
+    }
+    
+    unsigned getMaxCodeLength() const {
+        unsigned longest = 0;
+        for (int symbol = 0; symbol < 256; symbol++) {
+            longest = max(longest, (unsigned)huffmanCodes[symbol].len);
+        }
+        return longest;
+    }
+    
+    int getUniqueChars() const {
+        int unique = 0;
+        for (int symbol = 0; symbol < 256; symbol++) {
+            if (huffmanCodes[symbol].len > 0 || frequencies[symbol] > 0) unique++;
+        }
+        return unique;
+    }
+};
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              CODE-POINT CODER
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Huffman coding over UTF-8 code points instead of bytes, for text that is
+ * mostly multi-byte characters: "é" or "中" gets one code from its own
+ * frequency instead of two or three byte codes from a mixed distribution.
+ * A byte that is not part of well-formed UTF-8 becomes a symbol of its
+ * own (kRawByteSymbol + byte), so any input round-trips exactly.
+ *
+ * Compact table (getTable / loadTable), canonical codes as for bytes:
+ *   u8      flags: 0x01 = code lengths packed two per byte (all <= 15)
+ *   varint  symbol count n
+ *   varint  first symbol, then n - 1 gaps (symbol - previous - 1)
+ *   -       n code lengths in symbol order, a byte or a nibble (high first)
+ */
+static const uint32_t kRawByteSymbol = 0x110000;
+static const uint32_t kMaxCodePointSymbol = kRawByteSymbol + 255;
+static const uint8_t kTableNibbleLengths = 0x01;
+
+static inline void appendVarint(string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += (char)(value | 0x80);
+        value >>= 7;
+    }
+    out += (char)value;
+}
+
+static inline bool readVarint(const string& in, size_t& pos, uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64 && pos < in.length(); shift += 7) {
+        unsigned char b = (unsigned char)in[pos++];
+        value |= (uint64_t)(b & 0x7F) << shift;
+        if (b < 0x80) return true;
+    }
+    return false;
+}
+
+static const uint32_t kNoSymbolIndex = 0xFFFFFFFF;
+
+class CodePointCoder {
+private:
+    vector<uint32_t> symbols;           // Ascending
+    vector<uint32_t> counts;            // Per symbol; zero after loadTable()
+    vector<HuffmanCode> codes;          // Per symbol
+    vector<uint32_t> denseIndex;        // Symbol -> index for the low code points
+    unordered_map<uint32_t, uint32_t> sparseIndex;
+    HuffmanDecodeTable decodeTable;     // Decodes to symbol indices
+    unsigned longestCode;
+    
+    static const uint32_t kDenseLimit = 0x10000;    // Indexed directly below this
+    
+    static uint32_t nextSymbol(const unsigned char*& p, const unsigned char* end) {
+        size_t length = utf8SequenceLength(p, (size_t)(end - p));
+        if (length == 0) return kRawByteSymbol + *p++;
+        uint32_t codePoint = utf8CodePoint(p, length);
+        p += length;
+        return codePoint;
+    }
+    
+    static void appendSymbol(string& out, uint32_t symbol) {
+        if (symbol >= kRawByteSymbol) {
+            out += (char)(symbol - kRawByteSymbol);
+        } else {
+            appendUtf8(out, symbol);
+        }
+    }
+    
+    // JSON key of a symbol: the character itself, or "\xHH" for a raw byte
+    static string symbolLabel(uint32_t symbol) {
+        string label;
+        if (symbol >= kRawByteSymbol) {
+            static const char hexDigits[] = "0123456789abcdef";
+            unsigned byte = symbol - kRawByteSymbol;
+            label = "\\x";
+            label += hexDigits[byte >> 4];
+            label += hexDigits[byte & 15];
+        } else {
+            appendUtf8(label, symbol);
+        }
+        return label;
+    }
+    
+    uint32_t indexOf(uint32_t symbol) const {
+        if (symbol < denseIndex.size()) return denseIndex[symbol];
+        unordered_map<uint32_t, uint32_t>::const_iterator it = sparseIndex.find(symbol);
+        return it == sparseIndex.end() ? kNoSymbolIndex : it->second;
+    }
+    
+    // Same canonical order as HuffmanCoder: by (length, symbol)
+    void assignCanonicalCodes(const vector<unsigned>& lengths) {
+        size_t n = symbols.size();
+        vector<uint32_t> order(n);
+        for (size_t i = 0; i < n; i++) order[i] = (uint32_t)i;
+        stable_sort(order.begin(), order.end(), 
+                    [&](uint32_t a, uint32_t b) { return lengths[a] < lengths[b]; });
+        
+        codes.assign(n, HuffmanCode());
+        uint64_t code = 0;
+        unsigned previousLength = n == 0 ? 0 : lengths[order[0]];
+        for (size_t i = 0; i < n; i++) {
+            unsigned length = lengths[order[i]];
+            code <<= (length - previousLength);
+            previousLength = length;
+            codes[order[i]].bits = (uint32_t)code;
+            codes[order[i]].len = (uint8_t)length;
+            code++;
+        }
+        longestCode = previousLength;
+        
+        denseIndex.clear();
+        sparseIndex.clear();
+        uint32_t denseSize = 0;
+        while (denseSize < n && symbols[denseSize] < kDenseLimit) denseSize++;
+        if (denseSize > 0) denseIndex.assign(symbols[denseSize - 1] + 1, kNoSymbolIndex);
+        for (size_t i = 0; i < n; i++) {
+            if (i < denseSize) denseIndex[symbols[i]] = (uint32_t)i;
+            else sparseIndex[symbols[i]] = (uint32_t)i;
+        }
+        decodeTable.build(codes.data(), n);
+    }
+    
+public:
+    CodePointCoder() : longestCode(0) {}
+    
+    void calculateFrequencies(const char* bytes, size_t length) {
+        vector<uint32_t> dense;
+        unordered_map<uint32_t, uint32_t> sparse;
+        const unsigned char* p = (const unsigned char*)bytes;
+        const unsigned char* end = p + length;
+        while (p < end) {
+            uint32_t symbol = nextSymbol(p, end);
+            if (symbol < kDenseLimit) {
+                if (symbol >= dense.size()) dense.resize(max((size_t)symbol + 1, dense.size() * 2));
+                dense[symbol]++;
+            } else {
+                sparse[symbol]++;
+            }
+        }
+        
+        symbols.clear();
+        counts.clear();
+        for (uint32_t symbol = 0; symbol < dense.size(); symbol++) {
+            if (dense[symbol] == 0) continue;
+            symbols.push_back(symbol);
+            counts.push_back(dense[symbol]);
+        }
+        vector<pair<uint32_t, uint32_t> > rest(sparse.begin(), sparse.end());
+        sort(rest.begin(), rest.end());
+        for (size_t i = 0; i < rest.size(); i++) {
+            symbols.push_back(rest[i].first);
+            counts.push_back(rest[i].second);
+        }
+    }
+    
+    // As HuffmanCoder::buildTree, over however many symbols occur
+    void buildTree(unsigned maxCodeLength = kDefaultMaxCodeLength) {
+        size_t n = symbols.size();
+        vector<uint32_t> order(n);
+        for (size_t i = 0; i < n; i++) order[i] = (uint32_t)i;
+        sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return counts[a] != counts[b] ? counts[a] < counts[b] : a < b;
+        });
+        
+        maxCodeLength = min(max(maxCodeLength, 1u), kMaxCodeLength);
+        while (((size_t)1 << maxCodeLength) < n) maxCodeLength++;
+        
+        vector<uint64_t> weights(n);
+        for (size_t i = 0; i < n; i++) weights[i] = counts[order[i]];
+        computeCodeLengthsInPlace(weights.data(), n);
+        
+        vector<unsigned> lengths(n);
+        if (n > 0 && weights[0] > maxCodeLength) {
+            vector<uint64_t> sorted(n);
+            vector<unsigned> limited(n);
+            for (size_t i = 0; i < n; i++) sorted[i] = counts[order[i]];
+            computeLimitedCodeLengths(sorted.data(), n, maxCodeLength, limited.data());
+            for (size_t i = 0; i < n; i++) lengths[order[i]] = limited[i];
+        } else {
+            for (size_t i = 0; i < n; i++) lengths[order[i]] = (unsigned)weights[i];
+        }
+        assignCanonicalCodes(lengths);
+    }
+    
+    string getTable() const {
+        string table;
+        bool nibbles = longestCode <= 15;
+        table += (char)(nibbles ? kTableNibbleLengths : 0);
+        appendVarint(table, symbols.size());
+        for (size_t i = 0; i < symbols.size(); i++) {
+            appendVarint(table, i == 0 ? symbols[0] : symbols[i] - symbols[i - 1] - 1);
+        }
+        for (size_t i = 0; i < codes.size(); i++) {
+            if (!nibbles) {
+                table += (char)codes[i].len;
+            } else if (i % 2 == 0) {
+                table += (char)(codes[i].len << 4);
+            } else {
+                table[table.length() - 1] |= (char)codes[i].len;
+            }
+        }
+        return table;
+    }
+    
+    // Rebuilds the codes from getTable() output. Rejects anything that is
+    // not a complete prefix code over distinct, ascending symbols.
+    bool loadTable(const string& table) {
+        size_t pos = 1;
+        uint64_t n = 0;
+        if (table.empty() || ((unsigned char)table[0] & ~kTableNibbleLengths) != 0 ||
+            !readVarint(table, pos, n) || n > (uint64_t)kMaxCodePointSymbol + 1) {
+            return false;
+        }
+        bool nibbles = (table[0] & kTableNibbleLengths) != 0;
+        
+        vector<uint32_t> newSymbols((size_t)n);
+        uint64_t symbol = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t gap;
+            if (!readVarint(table, pos, gap)) return false;
+            symbol = i == 0 ? gap : symbol + gap + 1;
+            if (symbol > kMaxCodePointSymbol) return false;
+            newSymbols[i] = (uint32_t)symbol;
+        }
+        
+        size_t lengthBytes = nibbles ? (size_t)(n + 1) / 2 : (size_t)n;
+        if (table.length() - pos != lengthBytes) return false;
+        vector<unsigned> lengths((size_t)n);
+        uint64_t kraft = 0;
+        for (size_t i = 0; i < n; i++) {
+            unsigned char b = (unsigned char)table[pos + (nibbles ? i / 2 : i)];
+            unsigned length = !nibbles ? b : i % 2 == 0 ? b >> 4 : b & 15u;
+            if (length == 0 || length > kMaxCodeLength) return false;
+            lengths[i] = length;
+            kraft += 1ull << (kMaxCodeLength - length);
+        }
+        if (n > 1 && kraft != (1ull << kMaxCodeLength)) return false;
+        
+        symbols.swap(newSymbols);
+        counts.assign((size_t)n, 0);
+        assignCanonicalCodes(lengths);
+        return true;
+    }
+    
+    // Appends the packed code of the input; false if it holds a symbol the
+    // table has no code for
+    bool encodePacked(const char* bytes, size_t length, string& out, uint64_t& bitLength) const {
+        out.reserve(out.size() + length);
+        BitWriter writer(out);
+        const unsigned char* p = (const unsigned char*)bytes;
+        const unsigned char* end = p + length;
+        while (p < end) {
+            uint32_t index = indexOf(nextSymbol(p, end));
+            if (index == kNoSymbolIndex) return false;
+            writer.write(codes[index].bits, codes[index].len);
+        }
+        writer.flush();
+        bitLength = writer.getTotalBits();
+        return true;
+    }
+    
+    bool decodePacked(const char* bytes, size_t size, uint64_t bitLength, string& out) const {
+        vector<uint32_t> indices;
+        if (!decodeTable.decodeValues(bytes, size, bitLength, indices)) return false;
+        out.reserve(out.size() + indices.size());
+        for (size_t i = 0; i < indices.size(); i++) {
+            appendSymbol(out, symbols[indices[i]]);
+        }
+        return true;
+    }
+    
+    // {"<character>": count, ...}
+    void writeFrequencies(JsonWriter& json) const {
+        json.beginObject();
+        for (size_t i = 0; i < symbols.size(); i++) {
+            json.key(symbolLabel(symbols[i])).value((uint64_t)counts[i]);
+        }
+        json.endObject();
+    }
+    
+    // {"<character>": "0101", ...}
+    void writeCodes(JsonWriter& json) const {
+        json.beginObject();
+        for (size_t i = 0; i < symbols.size(); i++) {
+            json.key(symbolLabel(symbols[i])).value(codeToString(codes[i]));
+        }
+        json.endObject();
+    }
+    
+    size_t getUniqueSymbols() const {
+        return symbols.size();
+    }
+    
+    unsigned getMaxCodeLength() const {
+        return longestCode;
+    }
+};
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              ADAPTIVE CODER
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * One-pass (dynamic) Huffman coding, Vitter's algorithm V. Encoder and
+ * decoder start from the same empty tree and update it identically after
+ * every byte, so no table is sent and each code can be written as soon as
+ * its byte is seen. The first occurrence of a byte is the code of the NYT
+ * ("not yet transmitted") leaf followed by the byte's 8 raw bits.
+ *
+ * After each update the tree is a Huffman tree for the counts so far, with
+ * the smallest height among them (Vitter's invariant: in the implicit
+ * numbering weights never decrease, and leaves precede internal nodes of
+ * the same weight). Codes are not length-limited and are read bit by bit,
+ * so this is several times slower than the table-driven static path.
+ *
+ * State carries over between calls: feed a stream a chunk at a time into
+ * one BitWriter, and decode it with another coder in the same order.
+ */
+static const unsigned kAdaptiveMaxNodes = 2 * 256 + 1;
+static const uint16_t kAdaptiveNytSymbol = 256;
+
+class AdaptiveHuffmanCoder {
+private:
+    struct Node {
+        uint64_t weight;
+        uint16_t parent;
+        uint16_t child[2];          // kNullNode for leaves
+        uint16_t symbol;            // leaves only
+        uint16_t order;             // implicit number, the root is highest
+    };
+    
+    Node nodes[kAdaptiveMaxNodes];
+    uint16_t byOrder[kAdaptiveMaxNodes];
+    uint16_t leafOf[256];           // kNullNode until the byte first occurs
+    uint16_t nyt;
+    uint16_t root;
+    uint16_t nodeCount;
+    
+    bool isLeaf(uint16_t n) const {
+        return nodes[n].child[0] == kNullNode;
+    }
+    
+    // Exchanges the tree positions (and numbers) of two nodes, neither an
+    // ancestor of the other
+    void swapNodes(uint16_t a, uint16_t b) {
+        uint16_t parentA = nodes[a].parent;
+        uint16_t parentB = nodes[b].parent;
+        unsigned sideA = nodes[parentA].child[1] == a;
+        unsigned sideB = nodes[parentB].child[1] == b;
+        nodes[parentA].child[sideA] = b;
+        nodes[parentB].child[sideB] = a;
+        nodes[a].parent = parentB;
+        nodes[b].parent = parentA;
+        
+        swap(nodes[a].order, nodes[b].order);
+        byOrder[nodes[a].order] = a;
+        byOrder[nodes[b].order] = b;
+    }
+    
+    // Highest-numbered node of the same weight and kind (leaf or internal)
+    uint16_t blockLeader(uint16_t n) const {
+        bool leaf = isLeaf(n);
+        uint16_t leader = n;
+        for (unsigned order = nodes[n].order + 1; order < kAdaptiveMaxNodes; order++) {
+            uint16_t next = byOrder[order];
+            if (nodes[next].weight != nodes[n].weight || isLeaf(next) != leaf) break;
+            leader = next;
+        }
+        return leader;
+    }
+    
+    // Moves p past the block that must precede it once its weight grows -
+    // internal nodes of its weight for a leaf, leaves of weight + 1 for an
+    // internal node - then increments it. Returns the next node to update.
+    uint16_t slideAndIncrement(uint16_t p) {
+        bool leaf = isLeaf(p);
+        uint64_t weight = nodes[p].weight;
+        uint16_t formerParent = nodes[p].parent;
+        
+        while (nodes[p].order + 1u < kAdaptiveMaxNodes) {
+            uint16_t next = byOrder[nodes[p].order + 1];
+            if (next == root) break;
+            bool slide = leaf ? !isLeaf(next) && nodes[next].weight == weight
+                              : isLeaf(next) && nodes[next].weight == weight + 1;
+            if (!slide) break;
+            swapNodes(p, next);
+        }
+        nodes[p].weight++;
+        return leaf ? nodes[p].parent : formerParent;
+    }
+    
+    void update(unsigned char symbol) {
+        uint16_t q = leafOf[symbol];
+        uint16_t leafToIncrement = kNullNode;
+        
+        if (q == kNullNode) {
+            // The NYT leaf becomes an internal node over a new NYT and the new leaf
+            uint16_t oldNyt = nyt;
+            uint16_t order = nodes[oldNyt].order;
+            uint16_t newLeaf = nodeCount++;
+            uint16_t newNyt = nodeCount++;
+            
+            Node leafNode = { 0, oldNyt, { kNullNode, kNullNode }, symbol, (uint16_t)(order - 1) };
+            Node nytNode = { 0, oldNyt, { kNullNode, kNullNode }, kAdaptiveNytSymbol, (uint16_t)(order - 2) };
+            nodes[newLeaf] = leafNode;
+            nodes[newNyt] = nytNode;
+            nodes[oldNyt].child[0] = newNyt;
+            nodes[oldNyt].child[1] = newLeaf;
+            byOrder[order - 1] = newLeaf;
+            byOrder[order - 2] = newNyt;
+            leafOf[symbol] = newLeaf;
+            nyt = newNyt;
+            
+            q = oldNyt;
+            leafToIncrement = newLeaf;
+        } else {
+            uint16_t leader = blockLeader(q);
+            if (leader != q) swapNodes(q, leader);
+            // The sibling of the NYT leaf is incremented after its parent
+            if (nodes[nodes[q].parent].child[0] == nyt) {
+                leafToIncrement = q;
+                q = nodes[q].parent;
+            }
+        }
+        
+        while (q != kNullNode) q = slideAndIncrement(q);
+        if (leafToIncrement != kNullNode) slideAndIncrement(leafToIncrement);
+    }
+    
+    // Writes the path from the root to node n
+    void writePath(uint16_t n, BitWriter& writer) const {
+        uint64_t code = 0;
+        unsigned length = 0;
+        for (; n != root && length < 32; n = nodes[n].parent) {
+            code |= (uint64_t)(nodes[nodes[n].parent].child[1] == n) << length++;
+        }
+        if (n == root) {
+            if (length > 0) writer.write((uint32_t)code, length);
+            return;
+        }
+        
+        // Deep leaf: the remaining, upper part of the path goes first
+        uint8_t upper[kAdaptiveMaxNodes];
+        unsigned count = 0;
+        for (; n != root; n = nodes[n].parent) {
+            upper[count++] = nodes[nodes[n].parent].child[1] == n;
+        }
+        while (count > 0) writer.write(upper[--count], 1);
+        writer.write((uint32_t)code, length);
+    }
+    
+public:
+    AdaptiveHuffmanCoder() {
+        reset();
+    }
+    
+    // Back to the empty tree (a lone NYT leaf)
+    void reset() {
+        Node rootNode = { 0, kNullNode, { kNullNode, kNullNode }, kAdaptiveNytSymbol, 
+                          (uint16_t)(kAdaptiveMaxNodes - 1) };
+        nodes[0] = rootNode;
+        byOrder[kAdaptiveMaxNodes - 1] = 0;
+        for (int symbol = 0; symbol < 256; symbol++) leafOf[symbol] = kNullNode;
+        nyt = root = 0;
+        nodeCount = 1;
+    }
+    
+    void encode(const char* bytes, size_t length, BitWriter& writer) {
+        const unsigned char* data = (const unsigned char*)bytes;
+        for (size_t i = 0; i < length; i++) {
+            uint16_t leaf = leafOf[data[i]];
+            if (leaf != kNullNode) {
+                writePath(leaf, writer);
+            } else {
+                writePath(nyt, writer);
+                writer.write(data[i], 8);
+            }
+            update(data[i]);
+        }
+    }
+    
+    // Decodes until the reader has consumed bitLength bits; false if a code
+    // runs past it
+    bool decode(BitReader& reader, uint64_t bitLength, string& out) {
+        while (reader.position() < bitLength) {
+            uint16_t n = root;
+            while (!isLeaf(n)) {
+                if (reader.available() == 0) reader.refill();
+                n = nodes[n].child[reader.peek(1)];
+                reader.consume(1);
+            }
+            
+            unsigned symbol = nodes[n].symbol;
+            if (n == nyt) {
+                if (reader.available() < 8) reader.refill();
+                symbol = reader.peek(8);
+                reader.consume(8);
+            }
+            if (reader.position() > bitLength) return false;
+            out += (char)symbol;
+            update((unsigned char)symbol);
+        }
+        return true;
+    }
+    
+    // One whole message from a fresh tree, appended to 'out' and padded to a
+    // byte; returns the bit length
+    uint64_t encodePacked(const char* bytes, size_t length, string& out) {
+        reset();
+        BitWriter writer(out);
+        encode(bytes, length, writer);
+        writer.flush();
+        return writer.getTotalBits();
+    }
+    
+    bool decodePacked(const char* bytes, size_t size, uint64_t bitLength, string& out) {
+        reset();
+        if (bitLength > (uint64_t)size * 8) return false;
+        BitReader reader(bytes, size);
+        return decode(reader, bitLength, out);
+    }
+    
+    size_t getUniqueSymbols() const {
+        return (nodeCount - 1) / 2;
+    }
+};
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              CODING ENGINES
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * The byte coders behind one interface (engine= on /api/encode and
+ * /api/decode, and the engine benchmarks):
+ *   static    two passes - histogram, then code; the code-length header
+ *             is the table the decoder needs
+ *   adaptive  one pass, codes emitted as bytes arrive; no table
+ * encode appends the packed code to 'out', sets 'table' and returns the
+ * bit length; decode appends to 'out' and fails on a bad table or stream.
+ */
+struct CodingEngine {
+    const char* name;
+    bool usesTable;             // false: the code adapts and 'table' stays empty
+    uint64_t (*encode)(const char* data, size_t length, unsigned maxCodeLength, string& table, string& out);
+    bool (*decode)(const char* bytes, size_t size, uint64_t bitLength, const string& table, string& out);
+};
+
+inline uint64_t encodeStatic(const char* data, size_t length, unsigned maxCodeLength, 
+                             string& table, string& out) {
+    HuffmanCoder coder;
+    coder.calculateFrequencies(data, length);
+    coder.buildTree(maxCodeLength);
+    table = coder.getCodeLengthHeader();
+    return coder.encodePacked(data, length, out);
+}
+
+inline bool decodeStatic(const char* bytes, size_t size, uint64_t bitLength, const string& table, 
+                         string& out) {
+    HuffmanCoder coder;
+    if (!coder.loadCodeLengthHeader(table)) return false;
+    out += coder.decodePacked(bytes, size, bitLength);
+    return true;
+}
+
+inline uint64_t encodeAdaptive(const char* data, size_t length, unsigned, string& table, string& out) {
+    table.clear();
+    AdaptiveHuffmanCoder coder;
+    return coder.encodePacked(data, length, out);
+}
+
+inline bool decodeAdaptive(const char* bytes, size_t size, uint64_t bitLength, const string& table, 
+                           string& out) {
+    AdaptiveHuffmanCoder coder;
+    return table.empty() && coder.decodePacked(bytes, size, bitLength, out);
+}
+
+static const CodingEngine kCodingEngines[] = {
+    { "static", true, encodeStatic, decodeStatic },
+    { "adaptive", false, encodeAdaptive, decodeAdaptive }
+};
+static const size_t kCodingEngineCount = sizeof(kCodingEngines) / sizeof(kCodingEngines[0]);
+
+// Null for an unknown name
+inline const CodingEngine* findCodingEngine(const string& name) {
+    for (size_t i = 0; i < kCodingEngineCount; i++) {
+        if (name == kCodingEngines[i].name) return &kCodingEngines[i];
+    }
+    return nullptr;
+}
+
+#endif // HUFFMAN_CODER_H
@@ -5,22 +5,43 @@
  * ╚══════════════════════════════════════════════════════════════════════════════╝
  * 
  * Simple HTTP server using Windows Sockets (no external dependencies)
- * Single-threaded version for maximum compatibility
+ * Event loop (epoll / poll / WSAPoll) with I/O and worker thread pools
  * 
  * Compile: g++ -o HuffmanServer HuffmanServer.cpp -std=c++11 -lws2_32
- * Run: ./HuffmanServer
+ *          (Linux/macOS: g++ -o HuffmanServer HuffmanServer.cpp -std=c++11 -pthread)
+ * Run: ./HuffmanServer [--port 8080] [--threads N] [--io-threads N]
+ *                      [--keep-alive 15] [--max-requests 1000] [--cache-max-age 0]
+ *                      [--log-level info] [--result-cache 64] [--max-body 1024]
+ *                      [--large-request 64] [--large-workers N] [--max-queued 1024]
+ *                      [--max-queued-large 64] [--io-timeout 30]
+ *      ./HuffmanServer compress IN OUT  /  ./HuffmanServer decompress IN OUT
  */
 
 #ifdef _WIN32
     #define _WIN32_WINNT 0x0601
     #include <winsock2.h>
     #include <ws2tcpip.h>
+    #include <mswsock.h>
+    #include <sys/stat.h>
     #pragma comment(lib, "ws2_32.lib")
 #else
     #include <sys/socket.h>
     #include <netinet/in.h>
     #include <arpa/inet.h>
     #include <unistd.h>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <signal.h>
+    #include <sys/time.h>
+    #include <netinet/tcp.h>
+    #include <sys/stat.h>
+    #include <dirent.h>
+    #include <sys/mman.h>
+    #include <cerrno>
+    #ifdef __linux__
+        #include <sys/epoll.h>
+        #include <sys/sendfile.h>
+    #endif
     #define closesocket close
     #define SOCKET int
     #define INVALID_SOCKET -1
@@ -32,634 +53,4699 @@
 #include <sstream>
 #include <fstream>
 #include <unordered_map>
-#include <queue>
+#include <array>
 #include <vector>
+#include <deque>
+#include <list>
 #include <iomanip>
 #include <ctime>
 #include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <exception>
+#include <cstdint>
+#include <cctype>
+#include <chrono>
+#include <random>
+
+#include "HuffmanCoder.h"
 
 using namespace std;
 
 // ═══════════════════════════════════════════════════════════════════════════════
-//                              HUFFMAN NODE STRUCTURE
+//                              THREAD POOL
 // ═══════════════════════════════════════════════════════════════════════════════
 
-struct HuffmanNode {
-    char ch;
-    int freq;
-    HuffmanNode* left;
-    HuffmanNode* right;
+class ThreadPool {
+private:
+    vector<thread> workers;
+    deque<function<void()> > tasks;
+    mutex queueMutex;
+    condition_variable queueReady;
+    bool stopping;
+    
+    void workerLoop() {
+        while (true) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                queueReady.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) return;
+                task = move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+    
+    struct ParallelForState {
+        size_t count;
+        const function<void(size_t)>* body;
+        atomic<size_t> next;
+        atomic<size_t> done;
+        mutex doneMutex;
+        condition_variable allDone;
+        exception_ptr error;
+        
+        ParallelForState(size_t n, const function<void(size_t)>* b) 
+            : count(n), body(b), next(0), done(0) {}
+        
+        void run() {
+            while (true) {
+                size_t index = next++;
+                if (index >= count) return;
+                try {
+                    (*body)(index);
+                } catch (...) {
+                    lock_guard<mutex> lock(doneMutex);
+                    if (!error) error = current_exception();
+                }
+                if (++done == count) {
+                    lock_guard<mutex> lock(doneMutex);
+                    allDone.notify_all();
+                }
+            }
+        }
+    };
+    
+public:
+    explicit ThreadPool(size_t threadCount) : stopping(false) {
+        for (size_t i = 0; i < threadCount; i++) {
+            workers.push_back(thread(&ThreadPool::workerLoop, this));
+        }
+    }
+    
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueReady.notify_all();
+        for (size_t i = 0; i < workers.size(); i++) {
+            workers[i].join();
+        }
+    }
+    
+    size_t size() const {
+        return workers.size();
+    }
+    
+    // Tasks submitted but not yet started
+    size_t pending() {
+        lock_guard<mutex> lock(queueMutex);
+        return tasks.size();
+    }
+    
+    void submit(function<void()> task) {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            tasks.push_back(move(task));
+        }
+        queueReady.notify_one();
+    }
+    
+    // Runs body(0..count-1) across the pool and waits for all of them. The
+    // calling thread claims indices too, so this cannot deadlock when called
+    // from a pool thread; helpers that start late find no work and return.
+    void parallelFor(size_t count, const function<void(size_t)>& body) {
+        if (count == 0) return;
+        if (count == 1 || workers.empty()) {
+            for (size_t i = 0; i < count; i++) body(i);
+            return;
+        }
+        
+        shared_ptr<ParallelForState> state = make_shared<ParallelForState>(count, &body);
+        size_t helpers = min(workers.size(), count - 1);
+        for (size_t i = 0; i < helpers; i++) {
+            submit([state] { state->run(); });
+        }
+        state->run();
+        
+        unique_lock<mutex> lock(state->doneMutex);
+        state->allDone.wait(lock, [&] { return state->done.load() == count; });
+        if (state->error) rethrow_exception(state->error);
+    }
+};
+
+/**
+ * Request workers with admission control. Jobs wait in one of two lanes,
+ * picked by size. An idle worker always takes a small job first, and at
+ * most largeSlots workers run large jobs at once, so a burst of big
+ * encodes (or long streams) leaves threads free for small requests. Each
+ * lane's queue is bounded: trySubmit() refuses a job rather than let the
+ * backlog, and with it every queued request's latency, grow without limit.
+ */
+enum WorkLane { kLaneSmall, kLaneLarge, kLaneCount };
+
+static const char* const kLaneNames[kLaneCount] = { "small", "large" };
+
+class WorkerPool {
+private:
+    vector<thread> workers;
+    deque<function<void()> > queues[kLaneCount];
+    size_t queueLimits[kLaneCount];
+    size_t largeSlots;
+    size_t runningLarge;
+    mutex queueMutex;
+    condition_variable queueReady;
+    bool stopping;
+    
+    // Once stopping, queued large jobs drain without the slot limit
+    bool runnable() const {
+        return !queues[kLaneSmall].empty() || 
+               (!queues[kLaneLarge].empty() && (runningLarge < largeSlots || stopping));
+    }
+    
+    void workerLoop() {
+        while (true) {
+            function<void()> task;
+            bool large;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                queueReady.wait(lock, [this] { return stopping || runnable(); });
+                if (!runnable()) return;
+                large = queues[kLaneSmall].empty();
+                deque<function<void()> >& queue = queues[large ? kLaneLarge : kLaneSmall];
+                task = move(queue.front());
+                queue.pop_front();
+                if (large) runningLarge++;
+            }
+            task();
+            if (large) {
+                {
+                    lock_guard<mutex> lock(queueMutex);
+                    runningLarge--;
+                }
+                // A large job waiting for the slot may now run on an idle worker
+                queueReady.notify_one();
+            }
+        }
+    }
+    
+public:
+    WorkerPool(size_t threadCount, size_t largeWorkers, size_t smallQueueLimit, size_t largeQueueLimit)
+        : largeSlots(max((size_t)1, min(largeWorkers, threadCount))), runningLarge(0), stopping(false) {
+        queueLimits[kLaneSmall] = smallQueueLimit;
+        queueLimits[kLaneLarge] = largeQueueLimit;
+        for (size_t i = 0; i < threadCount; i++) {
+            workers.push_back(thread(&WorkerPool::workerLoop, this));
+        }
+    }
+    
+    ~WorkerPool() {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueReady.notify_all();
+        for (size_t i = 0; i < workers.size(); i++) {
+            workers[i].join();
+        }
+    }
+    
+    size_t size() const {
+        return workers.size();
+    }
+    
+    size_t largeWorkers() const {
+        return largeSlots;
+    }
+    
+    // Jobs queued in a lane but not yet started
+    size_t pending(WorkLane lane) {
+        lock_guard<mutex> lock(queueMutex);
+        return queues[lane].size();
+    }
     
-    HuffmanNode(char c, int f) : ch(c), freq(f), left(nullptr), right(nullptr) {}
+    size_t pending() {
+        lock_guard<mutex> lock(queueMutex);
+        return queues[kLaneSmall].size() + queues[kLaneLarge].size();
+    }
     
-    ~HuffmanNode() {
-        delete left;
-        delete right;
+    // False (and the task is dropped) when the lane's queue is full
+    bool trySubmit(WorkLane lane, function<void()> task) {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            if (queues[lane].size() >= queueLimits[lane]) return false;
+            queues[lane].push_back(move(task));
+        }
+        queueReady.notify_one();
+        return true;
     }
 };
 
-struct CompareNode {
-    bool operator()(HuffmanNode* a, HuffmanNode* b) {
-        return a->freq > b->freq;
+// Shared pool for block-level coding work, one thread per core
+ThreadPool& codingPool() {
+    static ThreadPool pool(max(1u, thread::hardware_concurrency()));
+    return pool;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              STATIC MODELS
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * A static model is a code table trained ahead of time and chosen by name
+ * (model=text). For short messages this skips both the tree build and
+ * the table in the output, which together often outweigh the payload.
+ *
+ * Models are built once at startup: the built-ins below, plus one per
+ * file in ./models/ (the file is the training corpus; the model is named
+ * after the file without its extension). Every byte value gets one extra
+ * count so that any input can be encoded. After startup the registry is
+ * read-only, so workers share it without locking.
+ */
+static const size_t kMaxModelNameLength = 64;
+
+struct StaticModel {
+    string name;
+    string source;              // "built-in" or the training file
+    HuffmanCoder coder;         // codes and decode table, never modified
+    string table;               // code-length header, for clients
+    double bitsPerByte;         // expected code length on the training data
+};
+
+static const char kTextModelSample[] =
+    "The quick brown fox jumps over the lazy dog. It was the best of times, it was the worst "
+    "of times, it was the age of wisdom, it was the age of foolishness. Call me Ishmael. Some "
+    "years ago, never mind how long precisely, having little or no money in my purse, and "
+    "nothing particular to interest me on shore, I thought I would sail about a little and see "
+    "the watery part of the world. In the beginning the Universe was created. This has made a "
+    "lot of people very angry and been widely regarded as a bad move. All happy families are "
+    "alike; each unhappy family is unhappy in its own way. It is a truth universally "
+    "acknowledged, that a single man in possession of a good fortune, must be in want of a "
+    "wife. Whether I shall turn out to be the hero of my own life, or whether that station "
+    "will be held by anybody else, these pages must show.\n";
+
+static const char kJsonModelSample[] =
+    "{\"id\":\"a1f3c9e2\",\"ts\":1718031123456,\"host\":\"web-01\",\"service\":\"api\","
+    "\"level\":\"info\",\"event\":\"request\",\"method\":\"GET\",\"path\":\"/api/v1/users/1842\","
+    "\"status\":200,\"latency_ms\":12.84,\"bytes\":5321,\"tags\":[\"prod\",\"eu-west-1\"]}\n"
+    "{\"id\":\"b7d2e410\",\"ts\":1718031123519,\"host\":\"web-02\",\"service\":\"worker\","
+    "\"level\":\"warn\",\"event\":\"retry\",\"queue\":\"email\",\"attempt\":3,\"error\":null,"
+    "\"metrics\":{\"cpu\":0.73,\"mem_mb\":412,\"gc_pause_ms\":4.2},\"ok\":false}\n"
+    "{\"id\":\"c90a55d8\",\"ts\":1718031123601,\"host\":\"db-01\",\"service\":\"postgres\","
+    "\"level\":\"error\",\"event\":\"slow_query\",\"duration_ms\":1250,\"rows\":98,"
+    "\"user\":\"report\",\"sensor\":{\"temp\":21.5,\"humidity\":48,\"battery\":0.92}}\n";
+
+class ModelRegistry {
+private:
+    unordered_map<string, shared_ptr<const StaticModel> > models;
+    
+public:
+    static bool validName(const string& name) {
+        if (name.empty() || name.length() > kMaxModelNameLength) return false;
+        for (size_t i = 0; i < name.length(); i++) {
+            char c = name[i];
+            if (!isalnum((unsigned char)c) && c != '-' && c != '_' && c != '.') return false;
+        }
+        return true;
+    }
+    
+    // Trains a model from a byte histogram. Small training sets are scaled
+    // up first so the +1 smoothing does not swamp them.
+    bool add(const string& name, const string& source, const uint32_t counts[256]) {
+        if (!validName(name)) return false;
+        
+        uint64_t total = 0;
+        for (int symbol = 0; symbol < 256; symbol++) total += counts[symbol];
+        uint64_t scale = total > 0 && total < 65536 ? (65536 + total - 1) / total : 1;
+        
+        array<uint32_t, 256> smoothed;
+        for (int symbol = 0; symbol < 256; symbol++) {
+            uint64_t count = (uint64_t)counts[symbol] * scale + 1;
+            smoothed[symbol] = (uint32_t)min(count, (uint64_t)0xFFFFFFFFu);
+        }
+        
+        shared_ptr<StaticModel> model = make_shared<StaticModel>();
+        model->name = name;
+        model->source = source;
+        model->coder.setFrequencies(smoothed);
+        model->coder.buildTree();
+        model->table = model->coder.getCodeLengthHeader();
+        
+        uint64_t weightedBits = 0;
+        uint64_t weight = 0;
+        for (int symbol = 0; symbol < 256; symbol++) {
+            weightedBits += (uint64_t)smoothed[symbol] * model->coder.getCodeLength((unsigned char)symbol);
+            weight += smoothed[symbol];
+        }
+        model->bitsPerByte = (double)weightedBits / (double)weight;
+        
+        models[name] = model;
+        return true;
+    }
+    
+    bool add(const string& name, const string& source, const char* data, size_t length) {
+        uint32_t counts[256];
+        countFrequencies(data, length, counts);
+        return add(name, source, counts);
+    }
+    
+    void addBuiltIns() {
+        add("text", "built-in", kTextModelSample, sizeof(kTextModelSample) - 1);
+        add("json", "built-in", kJsonModelSample, sizeof(kJsonModelSample) - 1);
+    }
+    
+    // Null if there is no such model
+    const StaticModel* find(const string& name) const {
+        unordered_map<string, shared_ptr<const StaticModel> >::const_iterator it = models.find(name);
+        return it == models.end() ? nullptr : it->second.get();
+    }
+    
+    // Sorted by name
+    vector<const StaticModel*> list() const {
+        vector<const StaticModel*> sorted;
+        for (unordered_map<string, shared_ptr<const StaticModel> >::const_iterator it = models.begin(); 
+             it != models.end(); ++it) {
+            sorted.push_back(it->second.get());
+        }
+        sort(sorted.begin(), sorted.end(), [](const StaticModel* a, const StaticModel* b) {
+            return a->name < b->name;
+        });
+        return sorted;
     }
+    
+    size_t count() const {
+        return models.size();
+    }
+};
+
+ModelRegistry& staticModels() {
+    static ModelRegistry registry;
+    return registry;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              BLOCK FRAME FORMAT
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Large inputs are split into fixed-size blocks that are histogrammed and
+ * encoded independently on the coding pool. Integers are little-endian.
+ *
+ *   offset  size  field
+ *   0       4     magic "HUFB"
+ *   4       1     version (1)
+ *   5       1     flags (kFrameSharedTable, kFrameInterleaved, kFrameModel,
+ *                 kFrameChecksum)
+ *   6       2     reserved, 0
+ *   8       8     original size in bytes
+ *   16      4     block size in bytes (every block but the last is full)
+ *   20      4     block count
+ *   24      -     [kFrameSharedTable] u16 table size + code-length header
+ *                 [kFrameModel] u8 name length + name of a static model
+ *   -       12*n  block index: u64 payload offset (from the end of the
+ *                 index), u32 payload size, [kFrameChecksum] u32 CRC32C of
+ *                 the block's original bytes (16*n then)
+ *   -       -     block payloads
+ *
+ * Block payload: [unless kFrameSharedTable/kFrameModel] u16 table size + code-length
+ * header, then one u32 bit length per stream and the packed streams back to
+ * back. Blocks hold one stream, or four with kFrameInterleaved: stream s
+ * covers bytes [s * q, (s + 1) * q) of the block, q = ceil(size / 4),
+ * clamped to the block size.
+ *
+ * Checksums are per block, so each decode task checks its own output
+ * while it is still in cache, and a mismatch names the block.
+ */
+static const char kFrameMagic[4] = { 'H', 'U', 'F', 'B' };
+static const uint8_t kFrameVersion = 1;
+static const uint8_t kFrameSharedTable = 0x01;
+static const uint8_t kFrameInterleaved = 0x02;
+static const uint8_t kFrameModel = 0x04;
+static const uint8_t kFrameChecksum = 0x08;
+static const size_t kFrameHeaderSize = 24;
+static const size_t kFrameIndexEntrySize = 12;
+static const size_t kFrameChecksumSize = 4;
+static const size_t kDefaultBlockSize = 256 * 1024;
+static const size_t kMaxBlockSize = 64 * 1024 * 1024;
+
+struct FrameOptions {
+    size_t blockSize;
+    bool sharedTable;           // One table for all blocks instead of one per block
+    bool interleaved;           // Four streams per block
+    unsigned maxCodeLength;
+    const StaticModel* model;   // Code every block with this model instead
+    bool checksum;              // CRC32C per block (frames and streams)
+    
+    FrameOptions() : blockSize(kDefaultBlockSize), sharedTable(false), interleaved(false),
+                     maxCodeLength(kDefaultMaxCodeLength), model(nullptr), checksum(true) {}
 };
 
+static void putU16(string& out, uint16_t value) {
+    for (int i = 0; i < 2; i++) out += (char)(value >> (8 * i));
+}
+
+static void putU32(string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out += (char)(value >> (8 * i));
+}
+
+static void putU64(string& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) out += (char)(value >> (8 * i));
+}
+
+// Sums block histograms; if a count would overflow 32 bits, all counts are
+// scaled down together (keeping every used byte at least 1)
+static array<uint32_t, 256> mergeFrequencies(const vector<array<uint32_t, 256> >& blocks) {
+    uint64_t totals[256] = {0};
+    uint64_t largest = 0;
+    for (size_t b = 0; b < blocks.size(); b++) {
+        for (int symbol = 0; symbol < 256; symbol++) {
+            totals[symbol] += blocks[b][symbol];
+            largest = max(largest, totals[symbol]);
+        }
+    }
+    
+    unsigned shift = 0;
+    while ((largest >> shift) > 0xFFFFFFFFull) shift++;
+    
+    array<uint32_t, 256> merged;
+    for (int symbol = 0; symbol < 256; symbol++) {
+        uint64_t scaled = totals[symbol] >> shift;
+        merged[symbol] = (uint32_t)(totals[symbol] > 0 && scaled == 0 ? 1 : scaled);
+    }
+    return merged;
+}
+
+static uint16_t getU16(const char* p) {
+    const unsigned char* b = (const unsigned char*)p;
+    return (uint16_t)(b[0] | (b[1] << 8));
+}
+
+static uint32_t getU32(const char* p) {
+    const unsigned char* b = (const unsigned char*)p;
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static uint64_t getU64(const char* p) {
+    return (uint64_t)getU32(p) | ((uint64_t)getU32(p + 4) << 32);
+}
+
+// Byte range of stream s when a block of 'size' bytes is split four ways
+static void interleavedSegment(size_t size, int s, size_t& start, size_t& length) {
+    size_t quarter = (size + 3) / 4;
+    start = min(s * quarter, size);
+    length = min(start + quarter, size) - start;
+}
+
+// Appends the bit-length fields and packed streams of one block (no table)
+static void encodeBlockStreams(const HuffmanCoder& coder, const char* data, size_t size,
+                               bool interleaved, string& payload) {
+    int streams = interleaved ? 4 : 1;
+    size_t lengthsPos = payload.size();
+    for (int s = 0; s < streams; s++) putU32(payload, 0);
+    
+    for (int s = 0; s < streams; s++) {
+        size_t start = 0;
+        size_t length = size;
+        if (interleaved) interleavedSegment(size, s, start, length);
+        
+        uint64_t bits = coder.encodePacked(data + start, length, payload);
+        for (int i = 0; i < 4; i++) {
+            payload[lengthsPos + 4 * s + i] = (char)(bits >> (8 * i));
+        }
+    }
+}
+
+// Result of a block decode task besides 0 (corrupt) and 1 (ok)
+static const char kBlockChecksumMismatch = 2;
+
+static string blockError(uint64_t block, char result) {
+    stringstream message;
+    message << "Block " << block << (result == kBlockChecksumMismatch ? " fails its checksum" : " is corrupt");
+    return message.str();
+}
+
+// Decodes one block payload (after any table) into out[0..size)
+static bool decodeBlockStreams(const HuffmanDecodeTable& table, const char* payload, size_t payloadSize,
+                               bool interleaved, char* out, size_t size) {
+    int streams = interleaved ? 4 : 1;
+    if (payloadSize < (size_t)streams * 4) return false;
+    
+    const char* bytes[4];
+    size_t sizes[4];
+    uint64_t bitLengths[4];
+    size_t offset = streams * 4;
+    for (int s = 0; s < streams; s++) {
+        bitLengths[s] = getU32(payload + 4 * s);
+        sizes[s] = (size_t)((bitLengths[s] + 7) / 8);
+        if (sizes[s] > payloadSize - offset) return false;
+        bytes[s] = payload + offset;
+        offset += sizes[s];
+    }
+    
+    if (!interleaved) {
+        return table.decodeSymbols(bytes[0], sizes[0], bitLengths[0], out, size);
+    }
+    
+    char* outputs[4];
+    size_t counts[4];
+    for (int s = 0; s < 4; s++) {
+        size_t start;
+        interleavedSegment(size, s, start, counts[s]);
+        outputs[s] = out + start;
+    }
+    return table.decodeInterleaved(bytes, sizes, bitLengths, outputs, counts);
+}
+
+// Self-contained block: u16 table size + code-length header, then the streams
+static void encodeBlockPayload(const char* data, size_t size, unsigned maxCodeLength,
+                               bool interleaved, string& payload) {
+    array<uint32_t, 256> counts;
+    countFrequencies(data, size, counts.data());
+    
+    HuffmanCoder blockCoder;
+    blockCoder.setFrequencies(counts);
+    blockCoder.buildTree(maxCodeLength);
+    
+    string table = blockCoder.getCodeLengthHeader();
+    putU16(payload, (uint16_t)table.length());
+    payload += table;
+    encodeBlockStreams(blockCoder, data, size, interleaved, payload);
+}
+
+static bool decodeBlockPayload(const char* payload, size_t payloadSize, bool interleaved,
+                               char* out, size_t size) {
+    if (payloadSize < 2) return false;
+    size_t tableSize = getU16(payload);
+    
+    HuffmanCoder blockCoder;
+    if (payloadSize - 2 < tableSize || 
+        !blockCoder.loadCodeLengthHeader(string(payload + 2, tableSize))) return false;
+    return decodeBlockStreams(blockCoder.getDecodeTable(), payload + 2 + tableSize,
+                              payloadSize - 2 - tableSize, interleaved, out, size);
+}
+
+string encodeFrame(const char* data, size_t length, const FrameOptions& options, ThreadPool& pool) {
+    size_t blockSize = min(max(options.blockSize, (size_t)1), kMaxBlockSize);
+    size_t blockCount = (length + blockSize - 1) / blockSize;
+    
+    const StaticModel* model = options.model;
+    bool sharedTable = options.sharedTable && !model;
+    vector<array<uint32_t, 256> > histograms(sharedTable ? blockCount : 0);
+    vector<string> payloads(blockCount);
+    vector<uint32_t> checksums(options.checksum ? blockCount : 0);
+    HuffmanCoder sharedCoder;
+    
+    if (sharedTable) {
+        pool.parallelFor(blockCount, [&](size_t b) {
+            size_t start = b * blockSize;
+            countFrequencies(data + start, min(blockSize, length - start), histograms[b].data());
+        });
+        sharedCoder.setFrequencies(mergeFrequencies(histograms));
+        sharedCoder.buildTree(options.maxCodeLength);
+    }
+    
+    pool.parallelFor(blockCount, [&](size_t b) {
+        size_t start = b * blockSize;
+        size_t size = min(blockSize, length - start);
+        
+        if (model) {
+            encodeBlockStreams(model->coder, data + start, size, options.interleaved, payloads[b]);
+        } else if (sharedTable) {
+            encodeBlockStreams(sharedCoder, data + start, size, options.interleaved, payloads[b]);
+        } else {
+            encodeBlockPayload(data + start, size, options.maxCodeLength, options.interleaved, payloads[b]);
+        }
+        if (options.checksum) checksums[b] = crc32c(data + start, size);
+    });
+    
+    string frame;
+    size_t payloadTotal = 0;
+    size_t entrySize = kFrameIndexEntrySize + (options.checksum ? kFrameChecksumSize : 0);
+    for (size_t b = 0; b < blockCount; b++) payloadTotal += payloads[b].length();
+    frame.reserve(kFrameHeaderSize + 2 + 256 + blockCount * entrySize + payloadTotal);
+    
+    frame.append(kFrameMagic, 4);
+    frame += (char)kFrameVersion;
+    frame += (char)((sharedTable ? kFrameSharedTable : 0) | 
+                    (options.interleaved ? kFrameInterleaved : 0) |
+                    (model ? kFrameModel : 0) |
+                    (options.checksum ? kFrameChecksum : 0));
+    putU16(frame, 0);
+    putU64(frame, length);
+    putU32(frame, (uint32_t)blockSize);
+    putU32(frame, (uint32_t)blockCount);
+    
+    if (sharedTable) {
+        string table = sharedCoder.getCodeLengthHeader();
+        putU16(frame, (uint16_t)table.length());
+        frame += table;
+    }
+    if (model) {
+        frame += (char)model->name.length();
+        frame += model->name;
+    }
+    
+    uint64_t offset = 0;
+    for (size_t b = 0; b < blockCount; b++) {
+        putU64(frame, offset);
+        putU32(frame, (uint32_t)payloads[b].length());
+        if (options.checksum) putU32(frame, checksums[b]);
+        offset += payloads[b].length();
+    }
+    for (size_t b = 0; b < blockCount; b++) {
+        frame += payloads[b];
+        string().swap(payloads[b]);
+    }
+    return frame;
+}
+
+// Decodes a whole frame, one block per task. Returns false (with 'error'
+// set) on any structural problem instead of trusting sizes from the input.
+// 'verified' (optional) tells whether the frame carried checksums; a block
+// that fails its checksum is an error like any other corruption.
+bool decodeFrame(const char* data, size_t length, string& out, string& error, ThreadPool& pool,
+                 bool* verified = nullptr) {
+    if (length < kFrameHeaderSize || memcmp(data, kFrameMagic, 4) != 0) {
+        error = "Not a HUFB frame";
+        return false;
+    }
+    uint8_t version = (uint8_t)data[4];
+    uint8_t flags = (uint8_t)data[5];
+    uint64_t originalSize = getU64(data + 8);
+    uint64_t blockSize = getU32(data + 16);
+    uint64_t blockCount = getU32(data + 20);
+    
+    if (version != kFrameVersion || 
+        (flags & ~(kFrameSharedTable | kFrameInterleaved | kFrameModel | kFrameChecksum)) != 0 ||
+        (flags & kFrameSharedTable && flags & kFrameModel)) {
+        error = "Unsupported frame version or flags";
+        return false;
+    }
+    // Every symbol takes at least one bit, which bounds the claimed size
+    if (blockSize == 0 || blockSize > kMaxBlockSize || originalSize > (uint64_t)length * 8 ||
+        blockCount != (originalSize + blockSize - 1) / blockSize) {
+        error = "Inconsistent frame header";
+        return false;
+    }
+    
+    size_t pos = kFrameHeaderSize;
+    HuffmanCoder sharedCoder;
+    bool sharedTable = (flags & kFrameSharedTable) != 0;
+    bool interleaved = (flags & kFrameInterleaved) != 0;
+    if (sharedTable) {
+        if (length - pos < 2 || length - pos - 2 < getU16(data + pos) ||
+            !sharedCoder.loadCodeLengthHeader(string(data + pos + 2, getU16(data + pos)))) {
+            error = "Invalid shared code table";
+            return false;
+        }
+        pos += 2 + getU16(data + pos);
+    }
+    const HuffmanDecodeTable* modelTable = nullptr;
+    if (flags & kFrameModel) {
+        size_t nameLength = pos < length ? (uint8_t)data[pos] : 0;
+        if (nameLength == 0 || length - pos - 1 < nameLength) {
+            error = "Invalid model reference";
+            return false;
+        }
+        string name(data + pos + 1, nameLength);
+        const StaticModel* model = staticModels().find(name);
+        if (!model) {
+            error = "Unknown model '" + name + "'";
+            return false;
+        }
+        modelTable = &model->coder.getDecodeTable();
+        pos += 1 + nameLength;
+    }
+    
+    bool checksummed = (flags & kFrameChecksum) != 0;
+    size_t entrySize = kFrameIndexEntrySize + (checksummed ? kFrameChecksumSize : 0);
+    if ((length - pos) / entrySize < blockCount) {
+        error = "Truncated block index";
+        return false;
+    }
+    const char* index = data + pos;
+    const char* payloads = index + blockCount * entrySize;
+    size_t payloadArea = length - pos - (size_t)blockCount * entrySize;
+    for (size_t b = 0; b < blockCount; b++) {
+        uint64_t offset = getU64(index + b * entrySize);
+        uint64_t size = getU32(index + b * entrySize + 8);
+        if (offset > payloadArea || size > payloadArea - offset) {
+            error = "Block index points outside the frame";
+            return false;
+        }
+    }
+    
+    out.assign((size_t)originalSize, '\0');
+    vector<char> blockOk(blockCount, 0);
+    pool.parallelFor((size_t)blockCount, [&](size_t b) {
+        const char* entry = index + b * entrySize;
+        const char* payload = payloads + getU64(entry);
+        size_t payloadSize = getU32(entry + 8);
+        size_t start = b * (size_t)blockSize;
+        size_t size = min((size_t)blockSize, (size_t)originalSize - start);
+        
+        if (sharedTable || modelTable) {
+            const HuffmanDecodeTable& table = modelTable ? *modelTable : sharedCoder.getDecodeTable();
+            blockOk[b] = decodeBlockStreams(table, payload, payloadSize, interleaved, &out[start], size);
+        } else {
+            blockOk[b] = decodeBlockPayload(payload, payloadSize, interleaved, &out[start], size);
+        }
+        if (blockOk[b] && checksummed && crc32c(&out[start], size) != getU32(entry + 12)) {
+            blockOk[b] = kBlockChecksumMismatch;
+        }
+    });
+    
+    for (size_t b = 0; b < blockCount; b++) {
+        if (blockOk[b] != 1) {
+            error = blockError(b, blockOk[b]);
+            out.clear();
+            return false;
+        }
+    }
+    if (verified) *verified = checksummed;
+    return true;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              BLOCK STREAM FORMAT
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Sequential variant of the frame for inputs too large to hold in memory:
+ * no index and no up-front size, so it can be written and read in one pass.
+ *
+ *   offset  size  field
+ *   0       4     magic "HUFS"
+ *   4       1     version (1)
+ *   5       1     flags (kFrameInterleaved, kFrameChecksum)
+ *   6       2     reserved, 0
+ *   8       -     blocks: u32 raw size, u32 payload size, [kFrameChecksum]
+ *                 u32 CRC32C of the raw bytes, payload
+ *   -       8     end marker: raw size 0, payload size 0 (and checksum 0)
+ *
+ * Payloads are self-contained frame block payloads (own table, then streams).
+ */
+static const char kStreamMagic[4] = { 'H', 'U', 'F', 'S' };
+static const uint8_t kStreamVersion = 1;
+static const size_t kStreamHeaderSize = 8;
+static const size_t kStreamBlockHeaderSize = 8;
+
+string encodeStreamHeader(bool interleaved, bool checksum) {
+    string header(kStreamMagic, 4);
+    header += (char)kStreamVersion;
+    header += (char)((interleaved ? kFrameInterleaved : 0) | (checksum ? kFrameChecksum : 0));
+    putU16(header, 0);
+    return header;
+}
+
+bool parseStreamHeader(const char* data, bool& interleaved, bool& checksum, string& error) {
+    if (memcmp(data, kStreamMagic, 4) != 0) {
+        error = "Not a HUFS stream";
+        return false;
+    }
+    if ((uint8_t)data[4] != kStreamVersion || ((uint8_t)data[5] & ~(kFrameInterleaved | kFrameChecksum)) != 0) {
+        error = "Unsupported stream version or flags";
+        return false;
+    }
+    interleaved = ((uint8_t)data[5] & kFrameInterleaved) != 0;
+    checksum = ((uint8_t)data[5] & kFrameChecksum) != 0;
+    return true;
+}
+
+// Bytes before each payload, and in the end marker
+static size_t streamRecordHeaderSize(bool checksum) {
+    return kStreamBlockHeaderSize + (checksum ? kFrameChecksumSize : 0);
+}
+
+// Appends one block record; size 0 writes the end marker
+void encodeStreamBlock(const char* data, size_t size, unsigned maxCodeLength, 
+                       bool interleaved, bool checksum, string& out) {
+    size_t recordStart = out.length();
+    putU32(out, (uint32_t)size);
+    putU32(out, 0);
+    if (checksum) putU32(out, size == 0 ? 0 : crc32c(data, size));
+    if (size == 0) return;
+    
+    encodeBlockPayload(data, size, maxCodeLength, interleaved, out);
+    uint32_t payloadSize = (uint32_t)(out.length() - recordStart - streamRecordHeaderSize(checksum));
+    for (int i = 0; i < 4; i++) {
+        out[recordStart + 4 + i] = (char)(payloadSize >> (8 * i));
+    }
+}
+
+// Checks a block record header before its payload is read. A payload can
+// never need more than 32 bits per byte plus a table.
+bool validStreamBlock(uint32_t rawSize, uint32_t payloadSize) {
+    return rawSize <= kMaxBlockSize && payloadSize >= 2 &&
+           payloadSize <= (uint64_t)rawSize * 4 + 65536 + 16;
+}
+
 // ═══════════════════════════════════════════════════════════════════════════════
-//                              HUFFMAN CODER CLASS
+//                              MESSAGE BATCH FORMAT
 // ═══════════════════════════════════════════════════════════════════════════════
 
-class HuffmanCoder {
+/**
+ * Many small messages coded in one request. The plain side is a message
+ * list: each message as a u32 size followed by its bytes, back to back.
+ * The coded side keeps the messages separate so each decodes on its own:
+ *
+ *   offset  size  field
+ *   0       4     magic "HUFM"
+ *   4       1     version (1)
+ *   5       1     flags (kFrameSharedTable, kFrameModel)
+ *   6       2     reserved, 0
+ *   8       4     message count
+ *   12      -     [kFrameSharedTable] u16 table size + code-length header
+ *                 [kFrameModel] u8 name length + name of a static model
+ *   -       -     messages: u32 raw size, u32 payload size, payload
+ *
+ * A payload is a single-stream frame block payload (own table unless the
+ * batch has a shared table or model); empty messages have no payload.
+ * With a shared table one histogram covers the whole batch, which saves
+ * a tree build and a table per message and suits short, similar records.
+ */
+static const char kBatchMagic[4] = { 'H', 'U', 'F', 'M' };
+static const uint8_t kBatchVersion = 1;
+static const size_t kBatchHeaderSize = 12;
+static const size_t kBatchRecordHeaderSize = 8;
+static const size_t kBatchGroupBytes = 64 * 1024;   // work per parallelFor task
+
+struct BatchMessage {
+    const char* data;
+    size_t size;
+};
+
+// Splits a message list; false if a size runs past the end of the body
+bool parseMessageList(const char* data, size_t length, vector<BatchMessage>& messages, string& error) {
+    size_t pos = 0;
+    while (pos < length) {
+        if (length - pos < 4 || getU32(data + pos) > length - pos - 4) {
+            stringstream message;
+            message << "Message " << messages.size() << " is truncated";
+            error = message.str();
+            return false;
+        }
+        BatchMessage item = { data + pos + 4, getU32(data + pos) };
+        if (item.size > kMaxBlockSize) {
+            error = "Messages are limited to 64 MB";
+            return false;
+        }
+        messages.push_back(item);
+        pos += 4 + item.size;
+    }
+    return true;
+}
+
+// Splits messages 0..count into consecutive runs of about kBatchGroupBytes,
+// so a batch of tiny messages is not one pool task per message
+static vector<size_t> groupMessages(const vector<size_t>& sizes) {
+    vector<size_t> starts(1, 0);
+    size_t bytes = 0;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        bytes += sizes[i] + kBatchRecordHeaderSize;
+        if (bytes >= kBatchGroupBytes && i + 1 < sizes.size()) {
+            starts.push_back(i + 1);
+            bytes = 0;
+        }
+    }
+    starts.push_back(sizes.size());
+    return starts;
+}
+
+string encodeBatch(const vector<BatchMessage>& messages, const FrameOptions& options, ThreadPool& pool) {
+    const StaticModel* model = options.model;
+    vector<size_t> sizes(messages.size());
+    size_t totalSize = 0;
+    for (size_t i = 0; i < messages.size(); i++) {
+        sizes[i] = messages[i].size;
+        totalSize += sizes[i];
+    }
+    // No table to share when every message is empty
+    bool sharedTable = options.sharedTable && !model && totalSize > 0;
+    vector<size_t> groups = groupMessages(sizes);
+    size_t groupCount = groups.size() - 1;
+    
+    HuffmanCoder sharedCoder;
+    if (sharedTable) {
+        vector<array<uint32_t, 256> > histograms(groupCount);
+        pool.parallelFor(groupCount, [&](size_t g) {
+            histograms[g].fill(0);
+            array<uint32_t, 256> counts;
+            for (size_t i = groups[g]; i < groups[g + 1]; i++) {
+                countFrequencies(messages[i].data, messages[i].size, counts.data());
+                for (int symbol = 0; symbol < 256; symbol++) histograms[g][symbol] += counts[symbol];
+            }
+        });
+        sharedCoder.setFrequencies(mergeFrequencies(histograms));
+        sharedCoder.buildTree(options.maxCodeLength);
+    }
+    
+    vector<string> records(groupCount);
+    pool.parallelFor(groupCount, [&](size_t g) {
+        string& out = records[g];
+        for (size_t i = groups[g]; i < groups[g + 1]; i++) {
+            size_t recordStart = out.length();
+            putU32(out, (uint32_t)messages[i].size);
+            putU32(out, 0);
+            if (messages[i].size == 0) continue;
+            
+            if (model || sharedTable) {
+                encodeBlockStreams(model ? model->coder : sharedCoder, messages[i].data, 
+                                   messages[i].size, false, out);
+            } else {
+                encodeBlockPayload(messages[i].data, messages[i].size, options.maxCodeLength, false, out);
+            }
+            uint32_t payloadSize = (uint32_t)(out.length() - recordStart - kBatchRecordHeaderSize);
+            for (int b = 0; b < 4; b++) out[recordStart + 4 + b] = (char)(payloadSize >> (8 * b));
+        }
+    });
+    
+    string batch(kBatchMagic, 4);
+    batch += (char)kBatchVersion;
+    batch += (char)((sharedTable ? kFrameSharedTable : 0) | (model ? kFrameModel : 0));
+    putU16(batch, 0);
+    putU32(batch, (uint32_t)messages.size());
+    if (sharedTable) {
+        string table = sharedCoder.getCodeLengthHeader();
+        putU16(batch, (uint16_t)table.length());
+        batch += table;
+    }
+    if (model) {
+        batch += (char)model->name.length();
+        batch += model->name;
+    }
+    
+    size_t total = batch.length();
+    for (size_t g = 0; g < groupCount; g++) total += records[g].length();
+    batch.reserve(total);
+    for (size_t g = 0; g < groupCount; g++) {
+        batch += records[g];
+        string().swap(records[g]);
+    }
+    return batch;
+}
+
+// Decodes a HUFM batch into a message list. Every record is checked before
+// any output is allocated; a message can hold at most 8 bytes per payload byte.
+bool decodeBatch(const char* data, size_t length, string& out, string& error, ThreadPool& pool) {
+    if (length < kBatchHeaderSize || memcmp(data, kBatchMagic, 4) != 0) {
+        error = "Not a HUFM batch";
+        return false;
+    }
+    uint8_t flags = (uint8_t)data[5];
+    if ((uint8_t)data[4] != kBatchVersion || (flags & ~(kFrameSharedTable | kFrameModel)) != 0 ||
+        (flags & kFrameSharedTable && flags & kFrameModel)) {
+        error = "Unsupported batch version or flags";
+        return false;
+    }
+    uint32_t count = getU32(data + 8);
+    if (count > (length - kBatchHeaderSize) / kBatchRecordHeaderSize) {
+        error = "Inconsistent batch header";
+        return false;
+    }
+    
+    size_t pos = kBatchHeaderSize;
+    HuffmanCoder sharedCoder;
+    const HuffmanDecodeTable* table = nullptr;
+    if (flags & kFrameSharedTable) {
+        if (length - pos < 2 || length - pos - 2 < getU16(data + pos) ||
+            !sharedCoder.loadCodeLengthHeader(string(data + pos + 2, getU16(data + pos)))) {
+            error = "Invalid shared code table";
+            return false;
+        }
+        table = &sharedCoder.getDecodeTable();
+        pos += 2 + getU16(data + pos);
+    }
+    if (flags & kFrameModel) {
+        size_t nameLength = pos < length ? (uint8_t)data[pos] : 0;
+        if (nameLength == 0 || length - pos - 1 < nameLength) {
+            error = "Invalid model reference";
+            return false;
+        }
+        string name(data + pos + 1, nameLength);
+        const StaticModel* model = staticModels().find(name);
+        if (!model) {
+            error = "Unknown model '" + name + "'";
+            return false;
+        }
+        table = &model->coder.getDecodeTable();
+        pos += 1 + nameLength;
+    }
+    
+    vector<size_t> payloadStarts(count);
+    vector<size_t> sizes(count);
+    vector<size_t> outputStarts(count);
+    size_t outputSize = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (length - pos < kBatchRecordHeaderSize) {
+            error = "Truncated batch";
+            return false;
+        }
+        uint64_t rawSize = getU32(data + pos);
+        uint64_t payloadSize = getU32(data + pos + 4);
+        pos += kBatchRecordHeaderSize;
+        if (payloadSize > length - pos || rawSize > kMaxBlockSize || rawSize > payloadSize * 8) {
+            stringstream message;
+            message << "Message " << i << " has an invalid size";
+            error = message.str();
+            return false;
+        }
+        payloadStarts[i] = pos;
+        sizes[i] = (size_t)rawSize;
+        outputStarts[i] = outputSize + 4;
+        outputSize += 4 + (size_t)rawSize;
+        pos += (size_t)payloadSize;
+    }
+    if (pos != length) {
+        error = "Trailing data after the last message";
+        return false;
+    }
+    
+    out.assign(outputSize, '\0');
+    vector<char> messageOk(count, 0);
+    vector<size_t> groups = groupMessages(sizes);
+    pool.parallelFor(groups.size() - 1, [&](size_t g) {
+        for (size_t i = groups[g]; i < groups[g + 1]; i++) {
+            char* target = &out[outputStarts[i] - 4];
+            for (int b = 0; b < 4; b++) target[b] = (char)(sizes[i] >> (8 * b));
+            if (sizes[i] == 0) {
+                messageOk[i] = 1;
+                continue;
+            }
+            const char* payload = data + payloadStarts[i];
+            size_t payloadSize = getU32(payload - 4);
+            messageOk[i] = table 
+                ? decodeBlockStreams(*table, payload, payloadSize, false, target + 4, sizes[i])
+                : decodeBlockPayload(payload, payloadSize, false, target + 4, sizes[i]);
+        }
+    });
+    
+    for (size_t i = 0; i < count; i++) {
+        if (!messageOk[i]) {
+            stringstream message;
+            message << "Message " << i << " is corrupt";
+            error = message.str();
+            out.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              HTTP SERVER
+// ═══════════════════════════════════════════════════════════════════════════════
+
+string getContentType(const string& path) {
+    if (path.find(".html") != string::npos) return "text/html; charset=utf-8";
+    if (path.find(".css") != string::npos) return "text/css; charset=utf-8";
+    if (path.find(".js") != string::npos) return "application/javascript; charset=utf-8";
+    if (path.find(".json") != string::npos) return "application/json; charset=utf-8";
+    if (path.find(".png") != string::npos) return "image/png";
+    if (path.find(".ico") != string::npos) return "image/x-icon";
+    return "text/plain; charset=utf-8";
+}
+
+string readFile(const string& path) {
+    ifstream file(path.c_str(), ios::binary | ios::ate);
+    if (!file.is_open()) return "";
+    
+    string content((size_t)file.tellg(), '\0');
+    file.seekg(0);
+    if (!content.empty()) file.read(&content[0], content.length());
+    return content;
+}
+
+/**
+ * Read-only view of a whole file, mapped with mmap (CreateFileMapping on
+ * Windows) so the coder reads the page cache directly instead of a copy.
+ * An empty file is a valid zero-length view.
+ */
+class MappedFile {
+private:
+    const char* ptr;
+    size_t len;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+    
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+    
+public:
+#ifdef _WIN32
+    MappedFile() : ptr(""), len(0), file(INVALID_HANDLE_VALUE), mapping(nullptr) {}
+#else
+    MappedFile() : ptr(""), len(0), fd(-1) {}
+#endif
+    
+    ~MappedFile() {
+        close();
+    }
+    
+    const char* data() const { return ptr; }
+    size_t length() const { return len; }
+    
+    bool open(const string& path, string& error) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 
+                           FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            error = "Cannot open " + path + " (error " + to_string(GetLastError()) + ")";
+            return false;
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || (uint64_t)size.QuadPart > (uint64_t)SIZE_MAX) {
+            error = "Cannot size " + path;
+            close();
+            return false;
+        }
+        if (size.QuadPart == 0) return true;
+        
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!view) {
+            error = "Cannot map " + path + " (error " + to_string(GetLastError()) + ")";
+            close();
+            return false;
+        }
+        ptr = (const char*)view;
+        len = (size_t)size.QuadPart;
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || 
+            (uint64_t)st.st_size > (uint64_t)SIZE_MAX) {
+            error = "Cannot open " + path + (fd < 0 ? string(": ") + strerror(errno) : string());
+            close();
+            return false;
+        }
+        if (st.st_size == 0) return true;
+        
+        void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED) {
+            error = "Cannot map " + path + ": " + strerror(errno);
+            close();
+            return false;
+        }
+    #ifdef MADV_SEQUENTIAL
+        madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+    #endif
+        ptr = (const char*)view;
+        len = (size_t)st.st_size;
+#endif
+        return true;
+    }
+    
+    void close() {
+#ifdef _WIN32
+        if (len > 0) UnmapViewOfFile(ptr);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (len > 0) munmap((void*)ptr, len);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        ptr = "";
+        len = 0;
+    }
+};
+
+bool writeFile(const string& path, const string& content, string& error) {
+    ofstream file(path.c_str(), ios::binary | ios::trunc);
+    if (file.is_open()) file.write(content.data(), (streamsize)content.length());
+    if (!file.is_open() || !file.good()) {
+        error = "Cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+bool equalsIgnoreCase(const char* a, const char* b, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) return false;
+    }
+    return true;
+}
+
+/**
+ * Non-owning view of bytes in a request buffer - C++11 has no
+ * std::string_view. Views are only valid while their buffer is unchanged.
+ */
+struct StrView {
+    const char* ptr;
+    size_t len;
+    
+    StrView() : ptr(""), len(0) {}
+    StrView(const char* p, size_t n) : ptr(p), len(n) {}
+    explicit StrView(const string& s) : ptr(s.data()), len(s.length()) {}
+    
+    const char* data() const { return ptr; }
+    size_t length() const { return len; }
+    bool empty() const { return len == 0; }
+    char operator[](size_t i) const { return ptr[i]; }
+    string str() const { return string(ptr, len); }
+    
+    StrView substr(size_t pos, size_t count = string::npos) const {
+        pos = min(pos, len);
+        return StrView(ptr + pos, min(count, len - pos));
+    }
+    
+    size_t find(char c, size_t pos = 0) const {
+        if (pos >= len) return string::npos;
+        const char* hit = (const char*)memchr(ptr + pos, c, len - pos);
+        return hit ? (size_t)(hit - ptr) : string::npos;
+    }
+    
+    size_t find(const char* needle, size_t pos = 0) const {
+        size_t n = strlen(needle);
+        if (pos > len || len - pos < n) return string::npos;
+        const char* hit = search(ptr + pos, ptr + len, needle, needle + n);
+        return hit == ptr + len && n > 0 ? string::npos : (size_t)(hit - ptr);
+    }
+    
+    bool operator==(const char* s) const {
+        return strlen(s) == len && memcmp(ptr, s, len) == 0;
+    }
+    
+    bool operator!=(const char* s) const {
+        return !(*this == s);
+    }
+    
+    bool equalsIgnoreCase(const char* s) const {
+        return strlen(s) == len && ::equalsIgnoreCase(ptr, s, len);
+    }
+    
+    bool containsIgnoreCase(const char* needle) const {
+        size_t n = strlen(needle);
+        for (size_t i = 0; i + n <= len; i++) {
+            if (::equalsIgnoreCase(ptr + i, needle, n)) return true;
+        }
+        return false;
+    }
+};
+
+ostream& operator<<(ostream& out, const StrView& view) {
+    return out.write(view.data(), view.length());
+}
+
+struct HttpHeader {
+    StrView name;
+    StrView value;
+};
+
+static const size_t kMaxHeaders = 64;
+
+/**
+ * A parsed request. Every field is a view into 'raw' (request line, headers
+ * and, for buffered routes, the body) or into 'bodyStorage' when the body
+ * arrived separately, so a request is never copied.
+ */
+struct HttpRequest {
+    StrView method;
+    StrView path;
+    StrView version;
+    StrView queryString;
+    StrView body;
+    HttpHeader headers[kMaxHeaders];
+    size_t headerCount;
+    uint64_t contentLength;
+    bool chunked;               // Transfer-Encoding: chunked
+    
+    string raw;
+    string bodyStorage;
+    
+    HttpRequest() : headerCount(0), contentLength(0), chunked(false) {}
+    
+private:
+    HttpRequest(const HttpRequest&);
+    HttpRequest& operator=(const HttpRequest&);
+};
+
+// Decodes %XX escapes and '+' in a query string component
+string urlDecode(StrView input) {
+    string output;
+    output.reserve(input.length());
+    for (size_t i = 0; i < input.length(); i++) {
+        if (input[i] == '+') {
+            output += ' ';
+        } else if (input[i] == '%' && i + 2 < input.length() &&
+                   isxdigit((unsigned char)input[i + 1]) && isxdigit((unsigned char)input[i + 2])) {
+            char hex[3] = { input[i + 1], input[i + 2], '\0' };
+            output += (char)strtol(hex, nullptr, 16);
+            i += 2;
+        } else {
+            output += input[i];
+        }
+    }
+    return output;
+}
+
+// Header names are case-insensitive (RFC 7230)
+StrView findHeader(const HttpRequest& req, const char* name) {
+    for (size_t i = 0; i < req.headerCount; i++) {
+        if (req.headers[i].name.equalsIgnoreCase(name)) return req.headers[i].value;
+    }
+    return StrView();
+}
+
+string getHeader(const HttpRequest& req, const char* name) {
+    return findHeader(req, name).str();
+}
+
+// Scans the query string in place; only the returned value is decoded
+string getQueryParam(const HttpRequest& req, const char* name, const string& defaultValue = "") {
+    StrView query = req.queryString;
+    size_t start = 0;
+    while (start < query.length()) {
+        size_t end = query.find('&', start);
+        if (end == string::npos) end = query.length();
+        
+        StrView pair = query.substr(start, end - start);
+        size_t eqPos = pair.find('=');
+        StrView key = pair.substr(0, eqPos);
+        bool escaped = key.find('%') != string::npos || key.find('+') != string::npos;
+        if (escaped ? urlDecode(key) == name : key == name) {
+            return eqPos == string::npos ? "" : urlDecode(pair.substr(eqPos + 1));
+        }
+        start = end + 1;
+    }
+    return defaultValue;
+}
+
+static bool isOptionalWhitespace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+/**
+ * Parses a request head (request line through the blank line) in a single
+ * pass, without allocating: every field becomes a view into 'head'.
+ * Content-Length and Transfer-Encoding are picked up on the way, so framing
+ * needs no second scan. Returns false on a malformed head, which includes
+ * any framing a proxy in front of us might read differently: an empty or
+ * conflicting repeated Content-Length, a Transfer-Encoding other than
+ * plain "chunked", or both headers at once.
+ */
+bool parseRequestHead(const char* head, size_t length, HttpRequest& req) {
+    const char* p = head;
+    const char* end = head + length;
+    
+    // Request line: METHOD SP target SP version CRLF
+    const char* lineEnd = (const char*)memchr(p, '\r', end - p);
+    if (!lineEnd || lineEnd + 1 >= end || lineEnd[1] != '\n') return false;
+    const char* methodEnd = (const char*)memchr(p, ' ', lineEnd - p);
+    if (!methodEnd || methodEnd == p) return false;
+    const char* targetStart = methodEnd + 1;
+    const char* targetEnd = (const char*)memchr(targetStart, ' ', lineEnd - targetStart);
+    if (!targetEnd || targetEnd == targetStart) return false;
+    
+    req.method = StrView(p, methodEnd - p);
+    req.version = StrView(targetEnd + 1, lineEnd - targetEnd - 1);
+    const char* queryStart = (const char*)memchr(targetStart, '?', targetEnd - targetStart);
+    if (queryStart) {
+        req.path = StrView(targetStart, queryStart - targetStart);
+        req.queryString = StrView(queryStart + 1, targetEnd - queryStart - 1);
+    } else {
+        req.path = StrView(targetStart, targetEnd - targetStart);
+    }
+    
+    // Header lines until the empty line
+    req.headerCount = 0;
+    req.contentLength = 0;
+    req.chunked = false;
+    bool hasLength = false;
+    bool hasEncoding = false;
+    p = lineEnd + 2;
+    while (p < end) {
+        lineEnd = (const char*)memchr(p, '\r', end - p);
+        if (!lineEnd || lineEnd + 1 >= end || lineEnd[1] != '\n') return false;
+        if (lineEnd == p) break;
+        
+        const char* colon = (const char*)memchr(p, ':', lineEnd - p);
+        if (!colon || colon == p || req.headerCount == kMaxHeaders) return false;
+        const char* valueStart = colon + 1;
+        const char* valueEnd = lineEnd;
+        while (valueStart < valueEnd && isOptionalWhitespace(*valueStart)) valueStart++;
+        while (valueEnd > valueStart && isOptionalWhitespace(valueEnd[-1])) valueEnd--;
+        
+        HttpHeader& header = req.headers[req.headerCount++];
+        header.name = StrView(p, colon - p);
+        header.value = StrView(valueStart, valueEnd - valueStart);
+        
+        if (header.name.equalsIgnoreCase("Content-Length")) {
+            if (valueStart == valueEnd) return false;
+            uint64_t value = 0;
+            for (const char* digit = valueStart; digit < valueEnd; digit++) {
+                if (*digit < '0' || *digit > '9' || value > 0xFFFFFFFFFFFFull) return false;
+                value = value * 10 + (*digit - '0');
+            }
+            if (hasLength && value != req.contentLength) return false;
+            req.contentLength = value;
+            hasLength = true;
+        } else if (header.name.equalsIgnoreCase("Transfer-Encoding")) {
+            if (hasEncoding || !header.value.equalsIgnoreCase("chunked")) return false;
+            req.chunked = true;
+            hasEncoding = true;
+        }
+        p = lineEnd + 2;
+    }
+    return !(hasLength && hasEncoding);
+}
+
+static void rebaseView(StrView& view, const char* from, size_t length, const char* to) {
+    if (view.ptr >= from && view.ptr <= from + length) view.ptr = to + (view.ptr - from);
+}
+
+// Points the head views at a copy of the head bytes
+void rebaseRequestHead(HttpRequest& req, const char* from, size_t length, const char* to) {
+    rebaseView(req.method, from, length, to);
+    rebaseView(req.path, from, length, to);
+    rebaseView(req.version, from, length, to);
+    rebaseView(req.queryString, from, length, to);
+    for (size_t i = 0; i < req.headerCount; i++) {
+        rebaseView(req.headers[i].name, from, length, to);
+        rebaseView(req.headers[i].value, from, length, to);
+    }
+}
+
+struct HttpResponse {
+    int status;
+    string contentType;
+    string body;
+    string extraHeaders;        // complete "Name: value\r\n" lines
+    bool chunked;               // body follows as Transfer-Encoding: chunked
+    
+    // Static assets are sent without copying them into 'body': from a
+    // shared cached buffer, or straight from disk for large files
+    shared_ptr<const string> sharedBody;
+    string filePath;
+    uint64_t fileLength;
+    
+    HttpResponse() : status(200), chunked(false), fileLength(0) {}
+    
+    uint64_t contentLength() const {
+        if (!filePath.empty()) return fileLength;
+        return sharedBody ? sharedBody->length() : body.length();
+    }
+};
+
+HttpResponse createResponse(int status, const string& contentType, const string& body,
+                            const string& extraHeaders = "") {
+    HttpResponse response;
+    response.status = status;
+    response.contentType = contentType;
+    response.body = body;
+    response.extraHeaders = extraHeaders;
+    return response;
+}
+
+// The {"error": ...} body every /api route fails with, binary routes included
+HttpResponse errorResponse(int status, const string& message, const string& extraHeaders = "") {
+    return createResponse(status, "application/json", "{\"error\":\"" + escapeJsonString(message) + "\"}",
+                          extraHeaders);
+}
+
+string formatResponseHead(const HttpResponse& response, bool keepAlive) {
+    stringstream head;
+    head << "HTTP/1.1 " << response.status << " ";
+    
+    switch (response.status) {
+        case 200: head << "OK"; break;
+        case 204: head << "No Content"; break;
+        case 304: head << "Not Modified"; break;
+        case 400: head << "Bad Request"; break;
+        case 404: head << "Not Found"; break;
+        case 408: head << "Request Timeout"; break;
+        case 413: head << "Payload Too Large"; break;
+        case 429: head << "Too Many Requests"; break;
+        case 500: head << "Internal Server Error"; break;
+        case 503: head << "Service Unavailable"; break;
+        default: head << "Unknown"; break;
+    }
+    
+    head << "\r\n";
+    head << "Content-Type: " << response.contentType << "\r\n";
+    if (response.chunked) {
+        head << "Transfer-Encoding: chunked\r\n";
+    } else if (response.status != 304) {
+        head << "Content-Length: " << response.contentLength() << "\r\n";
+    }
+    head << "Access-Control-Allow-Origin: *\r\n";
+    head << "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n";
+    head << "Access-Control-Allow-Headers: Content-Type, X-Huffman-Bit-Length, X-Huffman-Table, X-Huffman-Model, "
+            "X-Huffman-Alphabet, X-Huffman-Engine\r\n";
+    head << "Access-Control-Expose-Headers: X-Huffman-Bit-Length, X-Huffman-Table, X-Huffman-Model, "
+            "X-Huffman-Alphabet, X-Huffman-Engine, X-Huffman-Verified\r\n";
+    head << response.extraHeaders;
+    head << (keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
+    head << "\r\n";
+    
+    return head.str();
+}
+
+string getTimestamp() {
+    time_t now = time(0);
+    tm ltm;
+#ifdef _WIN32
+    localtime_s(&ltm, &now);
+#else
+    localtime_r(&now, &ltm);
+#endif
+    char buffer[32];
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &ltm);
+    return string(buffer);
+}
+
+// Standard base64 (RFC 4648) with padding
+string base64Encode(const string& input) {
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    
+    string output;
+    output.reserve(((input.length() + 2) / 3) * 4);
+    
+    size_t i = 0;
+    for (; i + 2 < input.length(); i += 3) {
+        uint32_t triple = ((uint32_t)(unsigned char)input[i] << 16) |
+                          ((uint32_t)(unsigned char)input[i + 1] << 8) |
+                          (uint32_t)(unsigned char)input[i + 2];
+        output += alphabet[(triple >> 18) & 0x3F];
+        output += alphabet[(triple >> 12) & 0x3F];
+        output += alphabet[(triple >> 6) & 0x3F];
+        output += alphabet[triple & 0x3F];
+    }
+    
+    size_t remaining = input.length() - i;
+    if (remaining > 0) {
+        uint32_t triple = (uint32_t)(unsigned char)input[i] << 16;
+        if (remaining == 2) triple |= (uint32_t)(unsigned char)input[i + 1] << 8;
+        output += alphabet[(triple >> 18) & 0x3F];
+        output += alphabet[(triple >> 12) & 0x3F];
+        output += remaining == 2 ? alphabet[(triple >> 6) & 0x3F] : '=';
+        output += '=';
+    }
+    return output;
+}
+
+// Returns false on characters outside the base64 alphabet
+bool base64Decode(const string& input, string& output) {
+    output.clear();
+    output.reserve(input.length() / 4 * 3);
+    
+    uint32_t accumulator = 0;
+    int bits = 0;
+    for (size_t i = 0; i < input.length(); i++) {
+        char c = input[i];
+        int value;
+        if (c >= 'A' && c <= 'Z') value = c - 'A';
+        else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') value = c - '0' + 52;
+        else if (c == '+' || c == '-') value = 62;
+        else if (c == '/' || c == '_') value = 63;
+        else if (c == '=') break;
+        else return false;
+        
+        accumulator = (accumulator << 6) | value;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            output += (char)(accumulator >> bits);
+        }
+    }
+    return true;
+}
+
+// Minimal field lookup for the flat JSON bodies the API accepts.
+// Returns the position just after "key": (whitespace skipped), or npos.
+size_t findJsonValue(StrView body, const string& key) {
+    string marker = "\"" + key + "\"";
+    size_t pos = body.find(marker.c_str());
+    if (pos == string::npos) return string::npos;
+    
+    pos += marker.length();
+    while (pos < body.length() && isspace((unsigned char)body[pos])) pos++;
+    if (pos >= body.length() || body[pos] != ':') return string::npos;
+    pos++;
+    while (pos < body.length() && isspace((unsigned char)body[pos])) pos++;
+    return pos;
+}
+
+// String values are returned raw (no unescaping) - they are bits or base64
+bool extractJsonString(StrView body, const string& key, string& value) {
+    size_t start = findJsonValue(body, key);
+    if (start == string::npos || start >= body.length() || body[start] != '"') return false;
+    
+    start++;
+    size_t end = body.find('"', start);
+    if (end == string::npos) return false;
+    
+    value = body.substr(start, end - start).str();
+    return true;
+}
+
+bool extractJsonNumber(StrView body, const string& key, uint64_t& value) {
+    size_t start = findJsonValue(body, key);
+    if (start == string::npos || start >= body.length() || !isdigit((unsigned char)body[start])) return false;
+    
+    // Views are not NUL-terminated, so no strtoull
+    value = 0;
+    for (size_t pos = start; pos < body.length() && isdigit((unsigned char)body[pos]); pos++) {
+        value = value * 10 + (body[pos] - '0');
+    }
+    return true;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              METRICS
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Request counters and per-stage latency histograms, exposed in the
+ * Prometheus text format at /api/metrics.
+ *
+ * Every thread records into its own ThreadMetrics block, registered once
+ * on first use, so the request path takes no locks and does no atomic
+ * read-modify-write: each counter has a single writer and is advanced with
+ * a relaxed load and store. A scrape sums all blocks.
+ *
+ * Latencies are kept in nanoseconds in HDR-style log-linear buckets: eight
+ * sub-buckets per power of two, so any recorded value is known to within
+ * 12.5%. The exposition maps them onto fixed 1-2.5-5 second boundaries and
+ * also reports p50/p90/p99/p999 computed from the full resolution.
+ */
+enum Stage {
+    kStageRecv,                 // reading the request from the socket
+    kStageParse,                // request line and headers
+    kStageQueue,                // waiting for a worker thread
+    kStageHistogram,
+    kStageTree,                 // code lengths, codes and decode table
+    kStageEncode,
+    kStageDecode,
+    kStageSerialize,            // JSON / base64 response body
+    kStageSend,
+    kStageTotal,                // request read to response sent
+    kStageCount
+};
+
+static const char* const kStageNames[kStageCount] = {
+    "recv", "parse", "queue", "histogram", "tree", "encode", "decode", "serialize", "send", "total"
+};
+
+enum Route {
+    kRouteEncode, kRouteDecode, kRouteCompress, kRouteDecompress, kRouteEncodeStream,
+    kRouteDecodeStream, kRouteEncodeBatch, kRouteDecodeBatch, kRouteModels, kRouteStatus, 
+    kRouteMetrics, kRouteStatic, kRouteCount
+};
+
+static const char* const kRouteNames[kRouteCount] = {
+    "encode", "decode", "compress", "decompress", "encode_stream", "decode_stream",
+    "encode_batch", "decode_batch", "models", "status", "metrics", "static"
+};
+
+static const int kStatusCodes[] = { 200, 204, 304, 400, 404, 408, 413, 429, 500, 503 };
+static const size_t kStatusCount = sizeof(kStatusCodes) / sizeof(kStatusCodes[0]) + 1;   // + other
+
+static const unsigned kLatencySubBucketBits = 3;
+static const size_t kLatencyBuckets = 320;          // up to 2^42 ns, over an hour
+
+typedef chrono::steady_clock MetricsClock;
+
+static size_t latencyBucket(uint64_t ns) {
+    const uint64_t subBuckets = 1u << kLatencySubBucketBits;
+    if (ns < subBuckets) return (size_t)ns;
+    unsigned exponent = 63;
+    while (!(ns >> exponent)) exponent--;
+    size_t index = (exponent - kLatencySubBucketBits + 1) * subBuckets +
+                   (size_t)((ns >> (exponent - kLatencySubBucketBits)) & (subBuckets - 1));
+    return min(index, kLatencyBuckets - 1);
+}
+
+// Largest value (exclusive) that lands in bucket 'index'
+static uint64_t latencyBucketLimit(size_t index) {
+    const uint64_t subBuckets = 1u << kLatencySubBucketBits;
+    if (index < subBuckets) return index + 1;
+    unsigned shift = (unsigned)(index / subBuckets) - 1;
+    return (subBuckets + index % subBuckets + 1) << shift;
+}
+
+struct ThreadMetrics {
+    atomic<uint64_t> latency[kStageCount][kLatencyBuckets];
+    atomic<uint64_t> latencySum[kStageCount];
+    atomic<uint64_t> requests[kRouteCount][kStatusCount];
+    atomic<uint64_t> bytesReceived;
+    atomic<uint64_t> bytesSent;
+    
+    ThreadMetrics() {
+        for (size_t s = 0; s < kStageCount; s++) {
+            for (size_t b = 0; b < kLatencyBuckets; b++) latency[s][b].store(0);
+            latencySum[s].store(0);
+        }
+        for (size_t r = 0; r < kRouteCount; r++) {
+            for (size_t c = 0; c < kStatusCount; c++) requests[r][c].store(0);
+        }
+        bytesReceived.store(0);
+        bytesSent.store(0);
+    }
+};
+
+// Single-writer increment; readers may see it a little late, never torn
+static inline void bump(atomic<uint64_t>& counter, uint64_t amount = 1) {
+    counter.store(counter.load(memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+class MetricsRegistry {
+private:
+    mutex threadsMutex;
+    vector<unique_ptr<ThreadMetrics> > threads;     // never freed; pool threads live forever
+    MetricsClock::time_point startedAt;
+    
+public:
+    atomic<int64_t> openConnections;
+    ThreadPool* ioPool;                             // for queue depths, set by main
+    WorkerPool* workerPool;
+    
+    MetricsRegistry() : startedAt(MetricsClock::now()), openConnections(0), 
+                        ioPool(nullptr), workerPool(nullptr) {}
+    
+    ThreadMetrics& local() {
+        static thread_local ThreadMetrics* metrics = nullptr;
+        if (!metrics) {
+            lock_guard<mutex> lock(threadsMutex);
+            threads.push_back(unique_ptr<ThreadMetrics>(new ThreadMetrics()));
+            metrics = threads.back().get();
+        }
+        return *metrics;
+    }
+    
+    // Snapshot of every thread's counters added together
+    void collect(ThreadMetrics& total) {
+        lock_guard<mutex> lock(threadsMutex);
+        for (size_t t = 0; t < threads.size(); t++) {
+            const ThreadMetrics& m = *threads[t];
+            for (size_t s = 0; s < kStageCount; s++) {
+                for (size_t b = 0; b < kLatencyBuckets; b++) {
+                    bump(total.latency[s][b], m.latency[s][b].load(memory_order_relaxed));
+                }
+                bump(total.latencySum[s], m.latencySum[s].load(memory_order_relaxed));
+            }
+            for (size_t r = 0; r < kRouteCount; r++) {
+                for (size_t c = 0; c < kStatusCount; c++) {
+                    bump(total.requests[r][c], m.requests[r][c].load(memory_order_relaxed));
+                }
+            }
+            bump(total.bytesReceived, m.bytesReceived.load(memory_order_relaxed));
+            bump(total.bytesSent, m.bytesSent.load(memory_order_relaxed));
+        }
+    }
+    
+    double uptimeSeconds() const {
+        return chrono::duration<double>(MetricsClock::now() - startedAt).count();
+    }
+};
+
+MetricsRegistry& metrics() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+void recordStage(Stage stage, MetricsClock::time_point start) {
+    uint64_t ns = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(MetricsClock::now() - start).count();
+    ThreadMetrics& m = metrics().local();
+    bump(m.latency[stage][latencyBucket(ns)]);
+    bump(m.latencySum[stage], ns);
+}
+
+// Records the time from construction to the end of the enclosing scope
+class StageTimer {
+private:
+    Stage stage;
+    MetricsClock::time_point start;
+    
+public:
+    explicit StageTimer(Stage s) : stage(s), start(MetricsClock::now()) {}
+    
+    ~StageTimer() {
+        recordStage(stage, start);
+    }
+};
+
+Route routeOf(const HttpRequest& req) {
+    static const char* const paths[kRouteStatic] = {
+        "/api/encode", "/api/decode", "/api/compress", "/api/decompress", "/api/encode/stream",
+        "/api/decode/stream", "/api/encode/batch", "/api/decode/batch", "/api/models", "/api/status", 
+        "/api/metrics"
+    };
+    for (int r = 0; r < kRouteStatic; r++) {
+        if (req.path == paths[r]) return (Route)r;
+    }
+    return kRouteStatic;
+}
+
+void recordRequest(Route route, int status) {
+    size_t index = 0;
+    while (index < kStatusCount - 1 && kStatusCodes[index] != status) index++;
+    bump(metrics().local().requests[route][index]);
+}
+
+void recordBytesReceived(size_t bytes) {
+    bump(metrics().local().bytesReceived, bytes);
+}
+
+void recordBytesSent(size_t bytes) {
+    bump(metrics().local().bytesSent, bytes);
+}
+
+// Value below which a fraction q of the samples fall, from the buckets
+static double latencyQuantile(const atomic<uint64_t>* buckets, uint64_t count, double q) {
+    if (count == 0) return 0;
+    uint64_t rank = (uint64_t)(q * (double)(count - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < kLatencyBuckets; b++) {
+        seen += buckets[b].load(memory_order_relaxed);
+        if (seen >= rank) return (double)latencyBucketLimit(b) * 1e-9;
+    }
+    return (double)latencyBucketLimit(kLatencyBuckets - 1) * 1e-9;
+}
+
+// Histogram boundaries in seconds: 1, 2.5 and 5 per decade from 1 us to 10 s
+static const double kLatencyBoundaries[] = {
+    1e-6, 2.5e-6, 5e-6, 1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 5e-3,
+    1e-2, 2.5e-2, 5e-2, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+};
+
+string formatMetrics(size_t workerQueueDepth, size_t ioQueueDepth, uint64_t droppedLogLines) {
+    unique_ptr<ThreadMetrics> total(new ThreadMetrics());
+    metrics().collect(*total);
+    
+    stringstream out;
+    out << "# HELP huffman_requests_total Requests answered, by route and status.\n";
+    out << "# TYPE huffman_requests_total counter\n";
+    for (size_t r = 0; r < kRouteCount; r++) {
+        for (size_t c = 0; c < kStatusCount; c++) {
+            uint64_t count = total->requests[r][c].load();
+            if (count == 0) continue;
+            out << "huffman_requests_total{route=\"" << kRouteNames[r] << "\",status=\"";
+            if (c < kStatusCount - 1) out << kStatusCodes[c]; else out << "other";
+            out << "\"} " << count << "\n";
+        }
+    }
+    
+    out << "# HELP huffman_received_bytes_total Bytes read from client sockets.\n";
+    out << "# TYPE huffman_received_bytes_total counter\n";
+    out << "huffman_received_bytes_total " << total->bytesReceived.load() << "\n";
+    out << "# HELP huffman_sent_bytes_total Bytes written to client sockets.\n";
+    out << "# TYPE huffman_sent_bytes_total counter\n";
+    out << "huffman_sent_bytes_total " << total->bytesSent.load() << "\n";
+    
+    out << "# HELP huffman_stage_duration_seconds Time spent per request stage.\n";
+    out << "# TYPE huffman_stage_duration_seconds histogram\n";
+    size_t boundaryCount = sizeof(kLatencyBoundaries) / sizeof(kLatencyBoundaries[0]);
+    for (size_t s = 0; s < kStageCount; s++) {
+        const atomic<uint64_t>* buckets = total->latency[s];
+        uint64_t cumulative = 0;
+        size_t b = 0;
+        for (size_t i = 0; i < boundaryCount; i++) {
+            uint64_t limit = (uint64_t)(kLatencyBoundaries[i] * 1e9 + 0.5);
+            for (; b < kLatencyBuckets && latencyBucketLimit(b) <= limit; b++) {
+                cumulative += buckets[b].load();
+            }
+            out << "huffman_stage_duration_seconds_bucket{stage=\"" << kStageNames[s] 
+                << "\",le=\"" << kLatencyBoundaries[i] << "\"} " << cumulative << "\n";
+        }
+        for (; b < kLatencyBuckets; b++) cumulative += buckets[b].load();
+        out << "huffman_stage_duration_seconds_bucket{stage=\"" << kStageNames[s] 
+            << "\",le=\"+Inf\"} " << cumulative << "\n";
+        out << "huffman_stage_duration_seconds_sum{stage=\"" << kStageNames[s] << "\"} " 
+            << (double)total->latencySum[s].load() * 1e-9 << "\n";
+        out << "huffman_stage_duration_seconds_count{stage=\"" << kStageNames[s] << "\"} " 
+            << cumulative << "\n";
+    }
+    
+    out << "# HELP huffman_stage_duration_quantile_seconds Stage latency quantiles (within 12.5%).\n";
+    out << "# TYPE huffman_stage_duration_quantile_seconds gauge\n";
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    for (size_t s = 0; s < kStageCount; s++) {
+        uint64_t count = 0;
+        for (size_t b = 0; b < kLatencyBuckets; b++) count += total->latency[s][b].load();
+        if (count == 0) continue;
+        for (size_t q = 0; q < 4; q++) {
+            out << "huffman_stage_duration_quantile_seconds{stage=\"" << kStageNames[s] 
+                << "\",quantile=\"" << quantiles[q] << "\"} " 
+                << latencyQuantile(total->latency[s], count, quantiles[q]) << "\n";
+        }
+    }
+    
+    out << "# HELP huffman_open_connections Client connections currently open.\n";
+    out << "# TYPE huffman_open_connections gauge\n";
+    out << "huffman_open_connections " << metrics().openConnections.load() << "\n";
+    out << "# HELP huffman_queued_tasks Tasks waiting for a thread, by pool.\n";
+    out << "# TYPE huffman_queued_tasks gauge\n";
+    out << "huffman_queued_tasks{pool=\"worker\"} " << workerQueueDepth << "\n";
+    out << "huffman_queued_tasks{pool=\"io\"} " << ioQueueDepth << "\n";
+    out << "# HELP huffman_log_dropped_total Log lines dropped because the log queue was full.\n";
+    out << "# TYPE huffman_log_dropped_total counter\n";
+    out << "huffman_log_dropped_total " << droppedLogLines << "\n";
+    out << "# HELP huffman_uptime_seconds Seconds since the server started.\n";
+    out << "# TYPE huffman_uptime_seconds gauge\n";
+    out << "huffman_uptime_seconds " << fixed << setprecision(0) << metrics().uptimeSeconds() << "\n";
+    return out.str();
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              LOGGING
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Request logging is asynchronous: a line is formatted on the calling
+ * thread, queued, and written by one background thread that flushes once
+ * per batch instead of once per line. Lines below the configured level
+ * (--log-level) cost nothing beyond the check. If the writer falls behind
+ * by kMaxQueuedLogLines, further lines are dropped and counted rather
+ * than blocking requests.
+ *
+ *   LogLine(kLogInfo) << "GET " << path;
+ */
+enum LogLevel { kLogError, kLogWarn, kLogInfo, kLogDebug };
+
+static const size_t kMaxQueuedLogLines = 10000;
+
+class Logger {
+private:
+    mutex queueMutex;
+    condition_variable queueReady;
+    deque<pair<LogLevel, string> > lines;
+    atomic<int> level;
+    atomic<uint64_t> dropped;
+    bool stopping;
+    thread writer;
+    
+    void writerLoop() {
+        deque<pair<LogLevel, string> > batch;
+        while (true) {
+            {
+                unique_lock<mutex> lock(queueMutex);
+                queueReady.wait(lock, [this] { return stopping || !lines.empty(); });
+                if (lines.empty()) return;
+                batch.swap(lines);
+            }
+            bool errors = false;
+            for (size_t i = 0; i < batch.size(); i++) {
+                if (batch[i].first <= kLogWarn) {
+                    cerr << batch[i].second;
+                    errors = true;
+                } else {
+                    cout << batch[i].second;
+                }
+            }
+            cout.flush();
+            if (errors) cerr.flush();
+            batch.clear();
+        }
+    }
+    
+public:
+    Logger() : level(kLogInfo), dropped(0), stopping(false) {
+        writer = thread(&Logger::writerLoop, this);
+    }
+    
+    ~Logger() {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueReady.notify_all();
+        writer.join();
+    }
+    
+    bool enabled(LogLevel lineLevel) const {
+        return lineLevel <= level.load(memory_order_relaxed);
+    }
+    
+    void setLevel(LogLevel newLevel) {
+        level.store(newLevel);
+    }
+    
+    uint64_t droppedLines() const {
+        return dropped.load();
+    }
+    
+    void write(LogLevel lineLevel, string line) {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            if (lines.size() >= kMaxQueuedLogLines) {
+                dropped++;
+                return;
+            }
+            lines.push_back(make_pair(lineLevel, move(line)));
+        }
+        queueReady.notify_one();
+    }
+};
+
+Logger& logger() {
+    static Logger instance;
+    return instance;
+}
+
+bool parseLogLevel(const string& name, LogLevel& level) {
+    if (name == "error") level = kLogError;
+    else if (name == "warn") level = kLogWarn;
+    else if (name == "info") level = kLogInfo;
+    else if (name == "debug") level = kLogDebug;
+    else return false;
+    return true;
+}
+
+// One log line, queued when the statement ends
+class LogLine {
+private:
+    LogLevel level;
+    unique_ptr<stringstream> stream;    // null when the level is disabled
+    
+    LogLine(const LogLine&);
+    LogLine& operator=(const LogLine&);
+    
+public:
+    explicit LogLine(LogLevel lineLevel) : level(lineLevel) {
+        if (logger().enabled(level)) stream.reset(new stringstream());
+    }
+    
+    ~LogLine() {
+        if (!stream) return;
+        *stream << '\n';
+        logger().write(level, stream->str());
+    }
+    
+    template <typename T>
+    LogLine& operator<<(const T& value) {
+        if (stream) *stream << value;
+        return *this;
+    }
+};
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              STATIC ASSETS
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * The web/ directory is loaded into memory once at startup and served from
+ * there. Files over kMaxCachedAssetSize stay on disk and are sent with
+ * sendfile/TransmitFile. A precompressed sibling (app.js.br, app.js.gz) is
+ * served to clients that accept it. Each asset is re-checked against the
+ * file's mtime and size at most once per kAssetCheckInterval, so edits show
+ * up without a restart.
+ *
+ * Assets are immutable once built; a reload swaps in a new one, and requests
+ * already holding the old one finish with it.
+ */
+static const uint64_t kMaxCachedAssetSize = 1024 * 1024;
+static const int kAssetCheckIntervalMs = 1000;
+
+struct FileInfo {
+    bool exists;
+    uint64_t size;
+    int64_t mtime;
+    
+    FileInfo() : exists(false), size(0), mtime(0) {}
+    
+    bool operator==(const FileInfo& other) const {
+        return exists == other.exists && size == other.size && mtime == other.mtime;
+    }
+};
+
+FileInfo statFile(const string& path) {
+    FileInfo info;
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_stat64(path.c_str(), &st) != 0 || (st.st_mode & _S_IFREG) == 0) return info;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return info;
+#endif
+    info.exists = true;
+    info.size = (uint64_t)st.st_size;
+    info.mtime = (int64_t)st.st_mtime;
+    return info;
+}
+
+// Appends the URL paths ("/css/site.css") of all regular files under dir
+void listFiles(const string& dir, const string& prefix, vector<string>& out) {
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE search = FindFirstFileA((dir + "\\*").c_str(), &entry);
+    if (search == INVALID_HANDLE_VALUE) return;
+    do {
+        string name = entry.cFileName;
+        if (name == "." || name == "..") continue;
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            listFiles(dir + "/" + name, prefix + "/" + name, out);
+        } else {
+            out.push_back(prefix + "/" + name);
+        }
+    } while (FindNextFileA(search, &entry));
+    FindClose(search);
+#else
+    DIR* handle = opendir(dir.c_str());
+    if (!handle) return;
+    while (dirent* entry = readdir(handle)) {
+        string name = entry->d_name;
+        if (name == "." || name == "..") continue;
+        struct stat st;
+        if (stat((dir + "/" + name).c_str(), &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            listFiles(dir + "/" + name, prefix + "/" + name, out);
+        } else if (S_ISREG(st.st_mode)) {
+            out.push_back(prefix + "/" + name);
+        }
+    }
+    closedir(handle);
+#endif
+}
+
+// Strong validator from the content, so identical rebuilds keep their ETag
+string contentEtag(const string& content) {
+    uint64_t hash = 0xCBF29CE484222325ull;             // FNV-1a
+    for (size_t i = 0; i < content.length(); i++) {
+        hash = (hash ^ (unsigned char)content[i]) * 0x100000001B3ull;
+    }
+    char buffer[40];
+    snprintf(buffer, sizeof(buffer), "\"%016llx-%llx\"", 
+             (unsigned long long)hash, (unsigned long long)content.length());
+    return buffer;
+}
+
+struct StaticAsset {
+    string filePath;
+    string contentType;
+    FileInfo file;
+    FileInfo gzipFile;
+    FileInfo brotliFile;
+    
+    shared_ptr<const string> content;       // null when served from disk
+    shared_ptr<const string> gzip;
+    shared_ptr<const string> brotli;
+    string etag;
+    string gzipEtag;
+    string brotliEtag;
+};
+
+// ETags of the encoded variants differ from the identity one (RFC 7232)
+static string variantEtag(const string& etag, const char* suffix) {
+    return etag.substr(0, etag.length() - 1) + suffix + "\"";
+}
+
+shared_ptr<const StaticAsset> loadAsset(const string& filePath, const string& urlPath) {
+    shared_ptr<StaticAsset> asset = make_shared<StaticAsset>();
+    asset->filePath = filePath;
+    asset->contentType = getContentType(urlPath);
+    asset->file = statFile(filePath);
+    if (!asset->file.exists) return shared_ptr<const StaticAsset>();
+    
+    if (asset->file.size <= kMaxCachedAssetSize) {
+        asset->content = make_shared<string>(readFile(filePath));
+        asset->etag = contentEtag(*asset->content);
+    } else {
+        char buffer[48];
+        snprintf(buffer, sizeof(buffer), "\"%llx-%llx\"", 
+                 (unsigned long long)asset->file.size, (unsigned long long)asset->file.mtime);
+        asset->etag = buffer;
+    }
+    
+    asset->gzipFile = statFile(filePath + ".gz");
+    if (asset->gzipFile.exists && asset->gzipFile.size <= kMaxCachedAssetSize) {
+        asset->gzip = make_shared<string>(readFile(filePath + ".gz"));
+        asset->gzipEtag = variantEtag(asset->etag, "-gzip");
+    }
+    asset->brotliFile = statFile(filePath + ".br");
+    if (asset->brotliFile.exists && asset->brotliFile.size <= kMaxCachedAssetSize) {
+        asset->brotli = make_shared<string>(readFile(filePath + ".br"));
+        asset->brotliEtag = variantEtag(asset->etag, "-br");
+    }
+    return asset;
+}
+
+class StaticAssetCache {
+private:
+    typedef chrono::steady_clock Clock;
+    
+    struct Entry {
+        shared_ptr<const StaticAsset> asset;
+        Clock::time_point checkedAt;
+    };
+    
+    string root;
+    string cacheControl;
+    mutex entriesMutex;
+    unordered_map<string, Entry> entries;
+    
+    bool stale(const StaticAsset& asset) const {
+        return !(statFile(asset.filePath) == asset.file) ||
+               !(statFile(asset.filePath + ".gz") == asset.gzipFile) ||
+               !(statFile(asset.filePath + ".br") == asset.brotliFile);
+    }
+    
+    void store(const string& urlPath, const shared_ptr<const StaticAsset>& asset) {
+        lock_guard<mutex> lock(entriesMutex);
+        if (asset) {
+            Entry& entry = entries[urlPath];
+            entry.asset = asset;
+            entry.checkedAt = Clock::now();
+        } else {
+            entries.erase(urlPath);
+        }
+    }
+    
+public:
+    StaticAssetCache() : cacheControl("no-cache") {}
+    
+    // maxAge 0 makes browsers revalidate every time (cheap with ETags)
+    void load(const string& directory, int maxAgeSeconds) {
+        root = directory;
+        if (maxAgeSeconds > 0) {
+            stringstream value;
+            value << "public, max-age=" << maxAgeSeconds;
+            cacheControl = value.str();
+        }
+        
+        vector<string> paths;
+        listFiles(root, "", paths);
+        for (size_t i = 0; i < paths.size(); i++) {
+            store(paths[i], loadAsset(root + paths[i], paths[i]));
+        }
+    }
+    
+    size_t count() {
+        lock_guard<mutex> lock(entriesMutex);
+        return entries.size();
+    }
+    
+    uint64_t cachedBytes() {
+        lock_guard<mutex> lock(entriesMutex);
+        uint64_t total = 0;
+        for (unordered_map<string, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+            const StaticAsset& asset = *it->second.asset;
+            if (asset.content) total += asset.content->length();
+            if (asset.gzip) total += asset.gzip->length();
+            if (asset.brotli) total += asset.brotli->length();
+        }
+        return total;
+    }
+    
+    const string& getCacheControl() const {
+        return cacheControl;
+    }
+    
+    // Null when the file does not exist. Unknown paths are looked up on
+    // disk, so files added after startup are picked up too.
+    shared_ptr<const StaticAsset> find(const string& urlPath) {
+        if (urlPath.find("..") != string::npos || urlPath.find('\\') != string::npos) {
+            return shared_ptr<const StaticAsset>();
+        }
+        
+        shared_ptr<const StaticAsset> asset;
+        bool check = true;
+        {
+            lock_guard<mutex> lock(entriesMutex);
+            unordered_map<string, Entry>::iterator it = entries.find(urlPath);
+            if (it != entries.end()) {
+                asset = it->second.asset;
+                Clock::time_point now = Clock::now();
+                check = now - it->second.checkedAt >= chrono::milliseconds(kAssetCheckIntervalMs);
+                if (check) it->second.checkedAt = now;
+            }
+        }
+        
+        if (check && (!asset || stale(*asset))) {
+            asset = loadAsset(root + urlPath, urlPath);
+            store(urlPath, asset);
+        }
+        return asset;
+    }
+};
+
+StaticAssetCache& staticAssets() {
+    static StaticAssetCache cache;
+    return cache;
+}
+
+// If-None-Match holds a list of (possibly weak) tags or "*"
+bool etagMatches(StrView ifNoneMatch, const string& etag) {
+    size_t start = 0;
+    while (start < ifNoneMatch.length()) {
+        size_t end = ifNoneMatch.find(',', start);
+        if (end == string::npos) end = ifNoneMatch.length();
+        
+        StrView tag = ifNoneMatch.substr(start, end - start);
+        while (!tag.empty() && isOptionalWhitespace(tag[0])) tag = tag.substr(1);
+        while (!tag.empty() && isOptionalWhitespace(tag[tag.length() - 1])) tag = tag.substr(0, tag.length() - 1);
+        if (tag.length() > 2 && tag[0] == 'W' && tag[1] == '/') tag = tag.substr(2);
+        if (tag == "*" || tag == etag.c_str()) return true;
+        start = end + 1;
+    }
+    return false;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              RESULT CACHE
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * XXH64 (xxHash, 64-bit variant). Roughly memory speed, so hashing a
+ * request body is cheap next to building a tree for it.
+ */
+static const uint64_t kXxPrime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t kXxPrime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t kXxPrime3 = 0x165667B19E3779F9ULL;
+static const uint64_t kXxPrime4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t kXxPrime5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotateLeft64(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t readLittleEndian64(const unsigned char* p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) value = (value << 8) | p[i];
+    return value;
+}
+
+static inline uint32_t readLittleEndian32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t xxh64Round(uint64_t acc, uint64_t input) {
+    acc += input * kXxPrime2;
+    return rotateLeft64(acc, 31) * kXxPrime1;
+}
+
+static inline uint64_t xxh64Merge(uint64_t acc, uint64_t lane) {
+    acc ^= xxh64Round(0, lane);
+    return acc * kXxPrime1 + kXxPrime4;
+}
+
+uint64_t xxh64(const char* data, size_t length, uint64_t seed = 0) {
+    const unsigned char* p = (const unsigned char*)data;
+    const unsigned char* end = p + length;
+    uint64_t hash;
+    
+    if (length >= 32) {
+        uint64_t v1 = seed + kXxPrime1 + kXxPrime2;
+        uint64_t v2 = seed + kXxPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kXxPrime1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = xxh64Round(v1, readLittleEndian64(p));
+            v2 = xxh64Round(v2, readLittleEndian64(p + 8));
+            v3 = xxh64Round(v3, readLittleEndian64(p + 16));
+            v4 = xxh64Round(v4, readLittleEndian64(p + 24));
+        }
+        hash = rotateLeft64(v1, 1) + rotateLeft64(v2, 7) + rotateLeft64(v3, 12) + rotateLeft64(v4, 18);
+        hash = xxh64Merge(hash, v1);
+        hash = xxh64Merge(hash, v2);
+        hash = xxh64Merge(hash, v3);
+        hash = xxh64Merge(hash, v4);
+    } else {
+        hash = seed + kXxPrime5;
+    }
+    hash += (uint64_t)length;
+    
+    for (; p + 8 <= end; p += 8) {
+        hash ^= xxh64Round(0, readLittleEndian64(p));
+        hash = rotateLeft64(hash, 27) * kXxPrime1 + kXxPrime4;
+    }
+    if (p + 4 <= end) {
+        hash ^= (uint64_t)readLittleEndian32(p) * kXxPrime1;
+        hash = rotateLeft64(hash, 23) * kXxPrime2 + kXxPrime3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        hash ^= (uint64_t)*p * kXxPrime5;
+        hash = rotateLeft64(hash, 11) * kXxPrime1;
+    }
+    
+    hash ^= hash >> 33;
+    hash *= kXxPrime2;
+    hash ^= hash >> 29;
+    hash *= kXxPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/**
+ * Finished /api/encode responses, keyed by the request body and every
+ * input that shapes the reply (query string, X-Huffman-Alphabet and
+ * X-Huffman-Engine), so a repeated request is answered without touching
+ * the coder.
+ *
+ * The key is an XXH64 of the body and options under a seed drawn once per
+ * process, so collisions cannot be precomputed. The hash only finds the
+ * entry: it also keeps the option string and a copy of the request body,
+ * and a hit needs both to match byte for byte - XXH64 is not collision
+ * resistant, and a collision must never hand one client another body's
+ * output. The copy counts against the byte budget. Responses are stored
+ * as shared immutable bodies and sent like cached static assets, without
+ * a copy.
+ *
+ * Entries are spread over independently locked shards by hash; each shard
+ * is an LRU list holding at most its share of the byte budget, and evicts
+ * from the cold end when an insert would exceed it. A response larger than
+ * an eighth of a shard is not cached, so one huge input cannot flush
+ * everything else.
+ */
+static const size_t kResultCacheShards = 16;
+static const size_t kResultEntryOverhead = 128;        // list node, map slot, strings
+
+struct ResultKey {
+    uint64_t hash;
+    string options;
+    StrView body;               // the request's, valid while it is handled
+};
+
+class ResultCache {
+private:
+    struct Entry {
+        uint64_t hash;
+        string options;
+        string input;                                   // request body the response is for
+        int status;
+        string contentType;
+        string extraHeaders;
+        shared_ptr<const string> body;
+        size_t cost;
+    };
+    
+    struct Shard {
+        mutex lock;
+        list<Entry> entries;                            // most recently used first
+        unordered_map<uint64_t, list<Entry>::iterator> index;
+        size_t bytes;
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t inserts;
+        uint64_t evictions;
+        
+        Shard() : bytes(0), hits(0), misses(0), inserts(0), evictions(0) {}
+    };
+    
+    Shard shards[kResultCacheShards];
+    size_t shardCapacity;
+    uint64_t seed;
+    
+    static uint64_t randomSeed() {
+        uint64_t clock = (uint64_t)chrono::high_resolution_clock::now().time_since_epoch().count();
+        try {
+            random_device device;
+            return ((uint64_t)device() << 32 | device()) ^ clock;
+        } catch (const exception&) {
+            return xxh64((const char*)&clock, sizeof(clock));
+        }
+    }
+    
+    Shard& shardFor(uint64_t hash) {
+        return shards[(hash >> 60) % kResultCacheShards];
+    }
+    
+    void erase(Shard& shard, list<Entry>::iterator it) {
+        shard.bytes -= it->cost;
+        shard.index.erase(it->hash);
+        shard.entries.erase(it);
+    }
+    
+public:
+    ResultCache() : shardCapacity(0), seed(randomSeed()) {}
+    
+    // Total budget in bytes, 0 to disable. Set once before serving.
+    void setCapacity(size_t bytes) {
+        shardCapacity = bytes / kResultCacheShards;
+        for (size_t s = 0; s < kResultCacheShards; s++) {
+            lock_guard<mutex> guard(shards[s].lock);
+            while (shards[s].bytes > shardCapacity) erase(shards[s], --shards[s].entries.end());
+        }
+    }
+    
+    bool enabled() const { return shardCapacity > 0; }
+    
+    ResultKey makeKey(const HttpRequest& req) const {
+        ResultKey key;
+        key.options = req.path.str() + "?" + req.queryString.str() + "\n" + 
+                      getHeader(req, "X-Huffman-Alphabet") + "\n" + getHeader(req, "X-Huffman-Engine");
+        key.body = req.body;
+        key.hash = xxh64(req.body.data(), req.body.length(), 
+                         xxh64(key.options.data(), key.options.length(), seed));
+        return key;
+    }
+    
+    bool lookup(const ResultKey& key, HttpResponse& response) {
+        Shard& shard = shardFor(key.hash);
+        lock_guard<mutex> guard(shard.lock);
+        unordered_map<uint64_t, list<Entry>::iterator>::iterator found = shard.index.find(key.hash);
+        if (found == shard.index.end() || found->second->options != key.options ||
+            found->second->input.length() != key.body.length() ||
+            memcmp(found->second->input.data(), key.body.data(), key.body.length()) != 0) {
+            shard.misses++;
+            return false;
+        }
+        
+        list<Entry>::iterator it = found->second;
+        shard.entries.splice(shard.entries.begin(), shard.entries, it);
+        shard.hits++;
+        response.status = it->status;
+        response.contentType = it->contentType;
+        response.extraHeaders = it->extraHeaders;
+        response.sharedBody = it->body;
+        return true;
+    }
+    
+    // Moves the response body into a shared buffer the cache keeps a
+    // reference to; the response itself stays ready to send
+    void insert(const ResultKey& key, HttpResponse& response) {
+        if (!response.sharedBody) {
+            response.sharedBody = make_shared<const string>(move(response.body));
+            response.body.clear();
+        }
+        
+        Entry entry;
+        entry.hash = key.hash;
+        entry.options = key.options;
+        entry.status = response.status;
+        entry.contentType = response.contentType;
+        entry.extraHeaders = response.extraHeaders;
+        entry.body = response.sharedBody;
+        entry.cost = entry.body->length() + key.body.length() + entry.options.length() + 
+                     entry.contentType.length() + entry.extraHeaders.length() + kResultEntryOverhead;
+        if (entry.cost > shardCapacity / 8) return;
+        entry.input = key.body.str();
+        
+        Shard& shard = shardFor(key.hash);
+        lock_guard<mutex> guard(shard.lock);
+        unordered_map<uint64_t, list<Entry>::iterator>::iterator found = shard.index.find(key.hash);
+        if (found != shard.index.end()) erase(shard, found->second);
+        while (shard.bytes + entry.cost > shardCapacity && !shard.entries.empty()) {
+            erase(shard, --shard.entries.end());
+            shard.evictions++;
+        }
+        
+        shard.bytes += entry.cost;
+        shard.entries.push_front(move(entry));
+        shard.index[key.hash] = shard.entries.begin();
+        shard.inserts++;
+    }
+    
+    void writeMetrics(ostream& out) {
+        uint64_t hits = 0, misses = 0, inserts = 0, evictions = 0;
+        size_t bytes = 0, entries = 0;
+        for (size_t s = 0; s < kResultCacheShards; s++) {
+            lock_guard<mutex> guard(shards[s].lock);
+            hits += shards[s].hits;
+            misses += shards[s].misses;
+            inserts += shards[s].inserts;
+            evictions += shards[s].evictions;
+            bytes += shards[s].bytes;
+            entries += shards[s].entries.size();
+        }
+        
+        out << "# HELP huffman_result_cache_requests_total Encode result cache lookups, by outcome.\n";
+        out << "# TYPE huffman_result_cache_requests_total counter\n";
+        out << "huffman_result_cache_requests_total{result=\"hit\"} " << hits << "\n";
+        out << "huffman_result_cache_requests_total{result=\"miss\"} " << misses << "\n";
+        out << "# HELP huffman_result_cache_inserts_total Responses stored in the result cache.\n";
+        out << "# TYPE huffman_result_cache_inserts_total counter\n";
+        out << "huffman_result_cache_inserts_total " << inserts << "\n";
+        out << "# HELP huffman_result_cache_evictions_total Entries evicted to stay within the byte budget.\n";
+        out << "# TYPE huffman_result_cache_evictions_total counter\n";
+        out << "huffman_result_cache_evictions_total " << evictions << "\n";
+        out << "# HELP huffman_result_cache_bytes Bytes held by the result cache.\n";
+        out << "# TYPE huffman_result_cache_bytes gauge\n";
+        out << "huffman_result_cache_bytes " << bytes << "\n";
+        out << "# HELP huffman_result_cache_capacity_bytes Result cache byte budget.\n";
+        out << "# TYPE huffman_result_cache_capacity_bytes gauge\n";
+        out << "huffman_result_cache_capacity_bytes " << shardCapacity * kResultCacheShards << "\n";
+        out << "# HELP huffman_result_cache_entries Responses held by the result cache.\n";
+        out << "# TYPE huffman_result_cache_entries gauge\n";
+        out << "huffman_result_cache_entries " << entries << "\n";
+    }
+};
+
+ResultCache& resultCache() {
+    static ResultCache cache;
+    return cache;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              REQUEST HANDLERS
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// maxCodeLength=1..32 caps the longest code (default 15) and model=name
+// selects a static model instead; for block formats also blockSize=bytes,
+// table=block|shared, streams=1|4, checksum=crc32c|none
+bool parseCodingOptions(const HttpRequest& req, FrameOptions& options, string& error) {
+    string modelName = getQueryParam(req, "model");
+    if (!modelName.empty()) {
+        options.model = staticModels().find(modelName);
+        if (!options.model) {
+            error = "Unknown model '" + modelName + "' - see /api/models";
+            return false;
+        }
+    }
+    
+    string maxLengthParam = getQueryParam(req, "maxCodeLength");
+    int maxCodeLength = maxLengthParam.empty() ? (int)kDefaultMaxCodeLength : atoi(maxLengthParam.c_str());
+    if (maxCodeLength < 1 || maxCodeLength > (int)kMaxCodeLength) {
+        error = "maxCodeLength must be between 1 and 32";
+        return false;
+    }
+    options.maxCodeLength = maxCodeLength;
+    
+    options.sharedTable = getQueryParam(req, "table", "block") == "shared";
+    options.interleaved = getQueryParam(req, "streams", "1") == "4";
+    string checksum = getQueryParam(req, "checksum", "crc32c");
+    if (checksum != "crc32c" && checksum != "none") {
+        error = "Unknown checksum - expected crc32c or none";
+        return false;
+    }
+    options.checksum = checksum == "crc32c";
+    string blockSizeParam = getQueryParam(req, "blockSize");
+    if (!blockSizeParam.empty()) {
+        options.blockSize = (size_t)strtoull(blockSizeParam.c_str(), nullptr, 10);
+    }
+    if (options.blockSize < 1 || options.blockSize > kMaxBlockSize) {
+        error = "blockSize must be between 1 and 67108864";
+        return false;
+    }
+    return true;
+}
+
+// Visualization sections of the JSON encode response. They are only built
+// when asked for: fields=frequencies,codes,tree or verbose=1 for all three.
+static const unsigned kFieldFrequencies = 0x1;
+static const unsigned kFieldCodes = 0x2;
+static const unsigned kFieldTree = 0x4;
+static const unsigned kAllFields = kFieldFrequencies | kFieldCodes | kFieldTree;
+
+bool parseEncodeFields(const HttpRequest& req, unsigned& fields, string& error) {
+    string verbose = getQueryParam(req, "verbose", "0");
+    fields = (verbose == "1" || verbose == "true") ? kAllFields : 0;
+    
+    string list = getQueryParam(req, "fields");
+    size_t start = 0;
+    while (start < list.length()) {
+        size_t end = list.find(',', start);
+        if (end == string::npos) end = list.length();
+        string name = list.substr(start, end - start);
+        
+        if (name == "frequencies") {
+            fields |= kFieldFrequencies;
+        } else if (name == "codes") {
+            fields |= kFieldCodes;
+        } else if (name == "tree") {
+            fields |= kFieldTree;
+        } else if (!name.empty()) {
+            error = "Unknown field '" + name + "' - expected frequencies, codes or tree";
+            return false;
+        }
+        start = end + 1;
+    }
+    return true;
+}
+
+// Code-point coding (alphabet=utf8): one symbol per UTF-8 character
+// instead of per byte. Comes from the query, an X-Huffman-Alphabet header
+// (binary bodies) or a JSON "alphabet" field.
+bool parseAlphabet(const HttpRequest& req, bool jsonBody, bool& codePoints, string& error) {
+    string alphabet = getQueryParam(req, "alphabet");
+    if (alphabet.empty() && !jsonBody) alphabet = getHeader(req, "X-Huffman-Alphabet");
+    if (alphabet.empty() && jsonBody) extractJsonString(req.body, "alphabet", alphabet);
+    if (!alphabet.empty() && alphabet != "bytes" && alphabet != "utf8") {
+        error = "Unknown alphabet - expected bytes or utf8";
+        return false;
+    }
+    codePoints = alphabet == "utf8";
+    return true;
+}
+
+// Coding engine (engine=static|adaptive, see CodingEngine). Comes from the
+// query, an X-Huffman-Engine header (binary bodies) or a JSON "engine" field.
+bool parseEngine(const HttpRequest& req, bool jsonBody, const CodingEngine*& engine, string& error) {
+    string name = getQueryParam(req, "engine");
+    if (name.empty() && !jsonBody) name = getHeader(req, "X-Huffman-Engine");
+    if (name.empty() && jsonBody) extractJsonString(req.body, "engine", name);
+    engine = findCodingEngine(name.empty() ? "static" : name);
+    if (!engine) {
+        error = "Unknown engine - expected static or adaptive";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Encode with a table-free engine (engine=adaptive): the bits, base64 and
+ * binary formats, without a table, tree, codes or frequencies since the
+ * code changes as it goes.
+ */
+HttpResponse handleEngineEncode(const HttpRequest& req, StrView text, const string& format,
+                                const FrameOptions& options, const CodingEngine& engine) {
+    if (format != "bits" && format != "base64" && format != "binary") {
+        return errorResponse(400, "engine=adaptive supports the bits, base64 and binary formats");
+    }
+    if (options.model || !getQueryParam(req, "maxCodeLength").empty() || 
+        !getQueryParam(req, "fields").empty()) {
+        return errorResponse(400, "engine=adaptive takes no model, maxCodeLength or fields");
+    }
+    
+    string packed, table;
+    MetricsClock::time_point stageStart = MetricsClock::now();
+    uint64_t bitLength = engine.encode(text.data(), text.length(), options.maxCodeLength, table, packed);
+    recordStage(kStageEncode, stageStart);
+    
+    LogLine(kLogDebug) << "  [ENCODE] Output length: " << bitLength << " bits (" << engine.name << ")";
+    
+    if (format == "binary") {
+        return createResponse(200, "application/octet-stream", packed, 
+            "X-Huffman-Bit-Length: " + to_string(bitLength) + "\r\n" +
+            "X-Huffman-Engine: " + engine.name + "\r\n");
+    }
+    
+    stageStart = MetricsClock::now();
+    JsonWriter json(packed.length() * (format == "bits" ? 8 : 2) + 512);
+    json.beginObject();
+    if (format == "base64") {
+        json.key("packed").value(base64Encode(packed));
+        json.key("bitLength").value(bitLength);
+    } else {
+        json.key("encoded").value(packedToBitString(packed, bitLength));
+    }
+    json.key("engine").value(engine.name);
+    json.key("stats").beginObject();
+    json.key("originalBits").value((uint64_t)text.length() * 8);
+    json.key("encodedBits").value(bitLength);
+    json.key("compressionRatio").value((1.0 - (double)bitLength / ((double)text.length() * 8)) * 100, 2);
+    json.endObject();
+    json.endObject();
+    
+    HttpResponse response = createResponse(200, "application/json", "");
+    response.body.swap(json.str());
+    recordStage(kStageSerialize, stageStart);
+    return response;
+}
+
+/**
+ * Encode with alphabet=utf8. Same formats and fields as byte coding
+ * except the tree, which only exists for the byte alphabet; the table is
+ * the compact CodePointCoder table.
+ */
+HttpResponse handleCodePointEncode(const HttpRequest& req, StrView text, const string& format,
+                                   const FrameOptions& options, unsigned fields) {
+    if (format != "bits" && format != "base64" && format != "binary") {
+        return errorResponse(400, "alphabet=utf8 supports the bits, base64 and binary formats");
+    }
+    if (options.model) {
+        return errorResponse(400, "Static models use the byte alphabet");
+    }
+    if (!getQueryParam(req, "fields").empty() && (fields & kFieldTree)) {
+        return errorResponse(400, "The tree field is only available for the byte alphabet");
+    }
+    
+    CodePointCoder coder;
+    {
+        StageTimer timer(kStageHistogram);
+        coder.calculateFrequencies(text.data(), text.length());
+    }
+    {
+        StageTimer timer(kStageTree);
+        coder.buildTree(options.maxCodeLength);
+    }
+    
+    string packed;
+    uint64_t bitLength = 0;
+    MetricsClock::time_point stageStart = MetricsClock::now();
+    coder.encodePacked(text.data(), text.length(), packed, bitLength);
+    recordStage(kStageEncode, stageStart);
+    
+    LogLine(kLogDebug) << "  [ENCODE] Output length: " << bitLength << " bits (" << coder.getUniqueSymbols() << " code points)";
+    
+    string table = base64Encode(coder.getTable());
+    if (format == "binary") {
+        return createResponse(200, "application/octet-stream", packed, 
+            "X-Huffman-Bit-Length: " + to_string(bitLength) + "\r\n" +
+            "X-Huffman-Alphabet: utf8\r\n" + 
+            "X-Huffman-Table: " + table + "\r\n");
+    }
+    
+    stageStart = MetricsClock::now();
+    JsonWriter json(packed.length() * (format == "bits" ? 8 : 2) + table.length() + (fields ? 16384 : 512));
+    json.beginObject();
+    if (format == "base64") {
+        json.key("packed").value(base64Encode(packed));
+        json.key("bitLength").value(bitLength);
+    } else {
+        json.key("encoded").value(packedToBitString(packed, bitLength));
+    }
+    json.key("alphabet").value("utf8");
+    json.key("table").value(table);
+    if (fields & kFieldFrequencies) {
+        coder.writeFrequencies(json.key("frequencies"));
+    }
+    if (fields & kFieldCodes) {
+        coder.writeCodes(json.key("codes"));
+    }
+    json.key("stats").beginObject();
+    json.key("originalBits").value((uint64_t)text.length() * 8);
+    json.key("encodedBits").value(bitLength);
+    json.key("compressionRatio").value((1.0 - (double)bitLength / ((double)text.length() * 8)) * 100, 2);
+    json.key("uniqueChars").value((uint64_t)coder.getUniqueSymbols());
+    json.key("maxCodeLength").value((uint64_t)coder.getMaxCodeLength());
+    json.endObject();
+    json.endObject();
+    
+    HttpResponse response = createResponse(200, "application/json", "");
+    response.body.swap(json.str());
+    recordStage(kStageSerialize, stageStart);
+    return response;
+}
+
+HttpResponse handleEncodeRequest(const HttpRequest& req) {
+    HttpResponse response;
+    StrView text = req.body;
+    
+    LogLine(kLogDebug) << "  [ENCODE] Input length: " << text.length() << " chars";
+    
+    if (text.empty()) {
+        response = errorResponse(400, "No text provided");
+    } else {
+        // format=bits (default) | base64 | binary | frame
+        string format = getQueryParam(req, "format", "bits");
+        
+        FrameOptions options;
+        unsigned fields = 0;
+        string error;
+        
+        bool codePoints = false;
+        const CodingEngine* engine = nullptr;
+        if (!parseCodingOptions(req, options, error) || !parseEncodeFields(req, fields, error) ||
+            !parseAlphabet(req, false, codePoints, error) || !parseEngine(req, false, engine, error)) {
+            response = errorResponse(400, error);
+        } else if (!engine->usesTable && codePoints) {
+            response = errorResponse(400, "engine=adaptive uses the byte alphabet");
+        } else if (!engine->usesTable) {
+            response = handleEngineEncode(req, text, format, options, *engine);
+        } else if (codePoints) {
+            response = handleCodePointEncode(req, text, format, options, fields);
+        } else if (format == "frame") {
+            // Block-parallel container
+            MetricsClock::time_point encodeStart = MetricsClock::now();
+            string frame = encodeFrame(text.data(), text.length(), options, codingPool());
+            recordStage(kStageEncode, encodeStart);
+            
+            LogLine(kLogDebug) << "  [ENCODE] Output length: " << frame.length() << " bytes framed";
+            
+            response = createResponse(200, "application/octet-stream", frame);
+        } else if (format != "bits" && format != "base64" && format != "binary") {
+            response = errorResponse(400, "Unknown format - expected bits, base64, binary or frame");
+        } else {
+            // Coding state is per request unless a shared static model is used
+            HuffmanCoder ownCoder;
+            const HuffmanCoder& coder = options.model ? options.model->coder : ownCoder;
+            if (!options.model) {
+                {
+                    StageTimer timer(kStageHistogram);
+                    ownCoder.calculateFrequencies(text.data(), text.length());
+                }
+                StageTimer timer(kStageTree);
+                ownCoder.buildTree(options.maxCodeLength);
+            }
+            
+            if (format == "binary") {
+                uint64_t bitLength = 0;
+                MetricsClock::time_point encodeStart = MetricsClock::now();
+                string packed = coder.encodePacked(text.data(), text.length(), bitLength);
+                recordStage(kStageEncode, encodeStart);
+                
+                LogLine(kLogDebug) << "  [ENCODE] Output length: " << bitLength << " bits (" << packed.length() << " bytes packed)";
+                
+                stringstream headers;
+                headers << "X-Huffman-Bit-Length: " << bitLength << "\r\n";
+                if (options.model) {
+                    headers << "X-Huffman-Model: " << options.model->name << "\r\n";
+                } else {
+                    headers << "X-Huffman-Table: " << base64Encode(coder.getCodeLengthHeader()) << "\r\n";
+                }
+                response = createResponse(200, "application/octet-stream", packed, headers.str());
+            } else {
+                string encoded;
+                uint64_t encodedBits = 0;
+                MetricsClock::time_point stageStart = MetricsClock::now();
+                if (format == "base64") {
+                    string packed = coder.encodePacked(text.data(), text.length(), encodedBits);
+                    recordStage(kStageEncode, stageStart);
+                    stageStart = MetricsClock::now();
+                    encoded = base64Encode(packed);
+                } else {
+                    encoded = coder.encode(text.data(), text.length());
+                    encodedBits = encoded.length();
+                    recordStage(kStageEncode, stageStart);
+                    stageStart = MetricsClock::now();
+                }
+                
+                LogLine(kLogDebug) << "  [ENCODE] Output length: " << encodedBits << " bits";
+                
+                JsonWriter json(encoded.length() + (fields ? 16384 : 512));
+                json.beginObject();
+                if (format == "base64") {
+                    json.key("packed").value(encoded);
+                    json.key("bitLength").value(encodedBits);
+                } else {
+                    json.key("encoded").value(encoded);
+                }
+                if (options.model) {
+                    json.key("model").value(options.model->name);
+                } else {
+                    json.key("table").value(base64Encode(coder.getCodeLengthHeader()));
+                }
+                if (fields & kFieldFrequencies) {
+                    coder.writeFrequencies(json.key("frequencies"));
+                }
+                if (fields & kFieldCodes) {
+                    coder.writeCodes(json.key("codes"));
+                }
+                if (fields & kFieldTree) {
+                    coder.writeTree(json.key("tree"));
+                }
+                json.key("stats").beginObject();
+                json.key("originalBits").value((uint64_t)text.length() * 8);
+                json.key("encodedBits").value(encodedBits);
+                json.key("compressionRatio").value(coder.getCompressionRatio(text.length(), encodedBits), 2);
+                json.key("uniqueChars").value((uint64_t)coder.getUniqueChars());
+                json.key("maxCodeLength").value((uint64_t)coder.getMaxCodeLength());
+                json.endObject();
+                json.endObject();
+                
+                response = createResponse(200, "application/json", "");
+                response.body.swap(json.str());
+                recordStage(kStageSerialize, stageStart);
+            }
+        }
+    }
+    return response;
+}
+
+// Whether a decoded frame was checked against its block checksums
+static string verifiedHeader(bool verified) {
+    return string("X-Huffman-Verified: ") + (verified ? "true" : "false") + "\r\n";
+}
+
+HttpResponse handleDecodeRequest(const HttpRequest& req) {
+    HttpResponse response;
+    // Accepted inputs: a HUFB frame (?format=frame), raw packed bytes
+    // (application/octet-stream with X-Huffman-Bit-Length), JSON
+    // {"packed","bitLength"}, or JSON {"encoded"}.
+    // Frames carry their own tables; the other forms need the code-length
+    // table from the encode response ("table" / X-Huffman-Table, base64),
+    // except with engine=adaptive, which has none.
+    // The output is JSON {"decoded"}, or the exact bytes with output=binary;
+    // for frames "verified" / X-Huffman-Verified says whether block
+    // checksums were checked.
+    string decoded;
+    string error;
+    bool verified = false;
+    bool binaryBody = getHeader(req, "Content-Type").find("application/octet-stream") == 0;
+    bool framed = getQueryParam(req, "format") == "frame";
+    bool codePoints = false;
+    
+    HuffmanCoder ownDecoder;
+    CodePointCoder codePointDecoder;
+    const HuffmanCoder* decoder = &ownDecoder;
+    const CodingEngine* engine = nullptr;
+    if (!parseAlphabet(req, !binaryBody, codePoints, error) || !parseEngine(req, !binaryBody, engine, error)) {
+        // Reported below
+    } else if (!engine->usesTable) {
+        if (framed || codePoints) error = "engine=adaptive decodes the bits, base64 and binary forms of bytes";
+    } else if (!framed) {
+        // A static model (query, X-Huffman-Model or JSON "model") replaces the table
+        string modelName = getQueryParam(req, "model");
+        if (modelName.empty() && binaryBody) modelName = getHeader(req, "X-Huffman-Model");
+        if (modelName.empty() && !binaryBody) extractJsonString(req.body, "model", modelName);
+        
+        string table = binaryBody ? getHeader(req, "X-Huffman-Table") : "";
+        if (!binaryBody) extractJsonString(req.body, "table", table);
+        
+        string header;
+        if (!modelName.empty() && codePoints) {
+            error = "Static models use the byte alphabet";
+        } else if (!modelName.empty()) {
+            const StaticModel* model = staticModels().find(modelName);
+            if (model) {
+                decoder = &model->coder;
+            } else {
+                error = "Unknown model '" + modelName + "' - see /api/models";
+            }
+        } else if (table.empty()) {
+            error = "Missing code table - pass 'table' (or 'model') from the encode response";
+        } else {
+            StageTimer timer(kStageTree);
+            if (!base64Decode(table, header) || 
+                !(codePoints ? codePointDecoder.loadTable(header) : ownDecoder.loadCodeLengthHeader(header))) {
+                error = "Invalid code table";
+            }
+        }
+    } else if (codePoints) {
+        error = "Frames use the byte alphabet";
+    }
+    
+    MetricsClock::time_point stageStart = MetricsClock::now();
+    
+    // Packed input of the non-frame forms
+    string storage;
+    const char* packed = nullptr;
+    size_t packedSize = 0;
+    uint64_t bitLength = 0;
+    
+    if (!error.empty()) {
+        // Reported below
+    } else if (framed) {
+        LogLine(kLogDebug) << "  [DECODE] Input length: " << req.body.length() << " bytes framed";
+        decodeFrame(req.body.data(), req.body.length(), decoded, error, codingPool(), &verified);
+    } else if (binaryBody) {
+        packed = req.body.data();
+        packedSize = req.body.length();
+        bitLength = (uint64_t)packedSize * 8;
+        string bitHeader = getHeader(req, "X-Huffman-Bit-Length");
+        if (!bitHeader.empty()) {
+            bitLength = strtoull(bitHeader.c_str(), nullptr, 10);
+        }
+    } else {
+        string base64;
+        string encoded;
+        
+        if (extractJsonString(req.body, "packed", base64)) {
+            if (!base64Decode(base64, storage)) {
+                error = "Invalid request format - 'packed' is not valid base64";
+            } else if (!extractJsonNumber(req.body, "bitLength", bitLength)) {
+                bitLength = (uint64_t)storage.length() * 8;
+            }
+        } else if (req.body.find("\"encoded\"") == string::npos) {
+            error = "Invalid request format - 'encoded' field not found";
+        } else if (!extractJsonString(req.body, "encoded", encoded)) {
+            error = "Invalid request format - malformed JSON";
+        } else {
+            bitLength = bitStringToPacked(encoded, storage);
+        }
+        packed = storage.data();
+        packedSize = storage.length();
+    }
+    
+    if (error.empty() && !framed) {
+        LogLine(kLogDebug) << "  [DECODE] Input length: " << bitLength << " bits (" << packedSize << " bytes packed)";
+        if (!engine->usesTable) {
+            if (!engine->decode(packed, packedSize, bitLength, "", decoded)) error = "Invalid code stream";
+        } else if (!codePoints) {
+            decoded = decoder->decodePacked(packed, packedSize, bitLength);
+        } else if (!codePointDecoder.decodePacked(packed, packedSize, bitLength, decoded)) {
+            error = "Invalid code stream";
+        }
+    }
+    
+    if (!error.empty()) {
+        LogLine(kLogWarn) << "  [DECODE] ERROR: " << error;
+        response = errorResponse(400, error);
+    } else if (getQueryParam(req, "output") == "binary") {
+        recordStage(kStageDecode, stageStart);
+        LogLine(kLogDebug) << "  [DECODE] Output length: " << decoded.length() << " bytes";
+        response = createResponse(200, "application/octet-stream", "",
+                                  framed ? verifiedHeader(verified) : "");
+        response.body.swap(decoded);
+    } else {
+        recordStage(kStageDecode, stageStart);
+        LogLine(kLogDebug) << "  [DECODE] Output length: " << decoded.length() << " chars";
+        
+        stageStart = MetricsClock::now();
+        JsonWriter json(decoded.length() + decoded.length() / 8 + 48);
+        json.beginObject().key("decoded").value(decoded);
+        if (framed) json.key("verified").boolean(verified);
+        json.endObject();
+        
+        response = createResponse(200, "application/json", "");
+        response.body.swap(json.str());
+        recordStage(kStageSerialize, stageStart);
+    }
+    return response;
+}
+
+/**
+ * Binary endpoints for service-to-service use: the body is the raw input
+ * and the response a HUFB frame (and back), both application/octet-stream.
+ * No JSON, no visualization payload; errors are the usual {"error": ...}
+ * JSON body. The query
+ * options are the same as /api/encode?format=frame.
+ */
+HttpResponse handleCompressRequest(const HttpRequest& req) {
+    FrameOptions options;
+    string error;
+    if (!parseCodingOptions(req, options, error)) {
+        return errorResponse(400, error);
+    }
+    
+    HttpResponse response = createResponse(200, "application/octet-stream", "");
+    {
+        StageTimer timer(kStageEncode);
+        response.body = encodeFrame(req.body.data(), req.body.length(), options, codingPool());
+    }
+    
+    LogLine(kLogDebug) << "  [COMPRESS] " << req.body.length() << " -> " << response.body.length() << " bytes";
+    return response;
+}
+
+HttpResponse handleDecompressRequest(const HttpRequest& req) {
+    HttpResponse response = createResponse(200, "application/octet-stream", "");
+    string error;
+    bool verified = false;
+    StageTimer timer(kStageDecode);
+    if (!decodeFrame(req.body.data(), req.body.length(), response.body, error, codingPool(), &verified)) {
+        LogLine(kLogWarn) << "  [DECOMPRESS] ERROR: " << error;
+        return errorResponse(400, error);
+    }
+    response.extraHeaders = verifiedHeader(verified);
+    
+    LogLine(kLogDebug) << "  [DECOMPRESS] " << req.body.length() << " -> " << response.body.length() << " bytes";
+    return response;
+}
+
+// Many small messages per request: a message list in, a HUFM batch out
+// (and back). Takes the maxCodeLength, table and model options of
+// /api/compress; table=shared builds one tree for the whole batch.
+HttpResponse handleBatchEncodeRequest(const HttpRequest& req) {
+    FrameOptions options;
+    vector<BatchMessage> messages;
+    string error;
+    if (!parseCodingOptions(req, options, error) || 
+        !parseMessageList(req.body.data(), req.body.length(), messages, error)) {
+        return errorResponse(400, error);
+    }
+    if (options.interleaved) {
+        return errorResponse(400, "Batches are single-stream; streams=4 applies to frames");
+    }
+    
+    HttpResponse response = createResponse(200, "application/octet-stream", "");
+    {
+        StageTimer timer(kStageEncode);
+        response.body = encodeBatch(messages, options, codingPool());
+    }
+    
+    LogLine(kLogDebug) << "  [BATCH] Encoded " << messages.size() << " messages, " << req.body.length() 
+                       << " -> " << response.body.length() << " bytes";
+    return response;
+}
+
+HttpResponse handleBatchDecodeRequest(const HttpRequest& req) {
+    HttpResponse response = createResponse(200, "application/octet-stream", "");
+    string error;
+    StageTimer timer(kStageDecode);
+    if (!decodeBatch(req.body.data(), req.body.length(), response.body, error, codingPool())) {
+        LogLine(kLogWarn) << "  [BATCH] ERROR: " << error;
+        return errorResponse(400, error);
+    }
+    
+    LogLine(kLogDebug) << "  [BATCH] Decoded " << req.body.length() << " -> " << response.body.length() << " bytes";
+    return response;
+}
+
+// Lists the static models with their code tables, so clients can also
+// encode and decode locally
+HttpResponse handleModelsRequest() {
+    vector<const StaticModel*> models = staticModels().list();
+    JsonWriter json(models.size() * 512 + 32);
+    json.beginObject().key("models").beginArray();
+    for (size_t i = 0; i < models.size(); i++) {
+        const StaticModel& model = *models[i];
+        json.beginObject();
+        json.key("name").value(model.name);
+        json.key("source").value(model.source);
+        json.key("table").value(base64Encode(model.table));
+        json.key("maxCodeLength").value((uint64_t)model.coder.getMaxCodeLength());
+        json.key("bitsPerByte").value(model.bitsPerByte, 3);
+        json.endObject();
+    }
+    json.endArray().endObject();
+    
+    HttpResponse response = createResponse(200, "application/json", "");
+    response.body.swap(json.str());
+    return response;
+}
+
+// Repeated encodes are answered from the result cache. The lookup runs on
+// the worker, so hashing a large body never holds up an I/O thread.
+HttpResponse handleCachedEncodeRequest(const HttpRequest& req) {
+    ResultCache& cache = resultCache();
+    if (!cache.enabled()) return handleEncodeRequest(req);
+    
+    ResultKey key = cache.makeKey(req);
+    HttpResponse response;
+    if (cache.lookup(key, response)) {
+        LogLine(kLogDebug) << "  [ENCODE] Result cache hit (" << response.contentLength() << " bytes)";
+        return response;
+    }
+    response = handleEncodeRequest(req);
+    if (response.status == 200) cache.insert(key, response);
+    return response;
+}
+
+HttpResponse handleMetricsRequest() {
+    MetricsRegistry& registry = metrics();
+    size_t workerQueue = registry.workerPool ? registry.workerPool->pending() : 0;
+    size_t ioQueue = registry.ioPool ? registry.ioPool->pending() : 0;
+    stringstream out;
+    out << formatMetrics(workerQueue, ioQueue, logger().droppedLines());
+    if (registry.workerPool) {
+        // Rejections show up in huffman_requests_total as 429 (large) and 503 (small)
+        out << "# HELP huffman_worker_lane_queued_tasks Worker jobs waiting, by admission lane.\n";
+        out << "# TYPE huffman_worker_lane_queued_tasks gauge\n";
+        for (int lane = 0; lane < kLaneCount; lane++) {
+            out << "huffman_worker_lane_queued_tasks{lane=\"" << kLaneNames[lane] << "\"} "
+                << registry.workerPool->pending((WorkLane)lane) << "\n";
+        }
+    }
+    resultCache().writeMetrics(out);
+    return createResponse(200, "text/plain; version=0.0.4", out.str());
+}
+
+HttpResponse handleStaticRequest(const HttpRequest& req) {
+    string path = req.path.str();
+    if (path == "/") path = "/index.html";
+    
+    shared_ptr<const StaticAsset> asset = staticAssets().find(path);
+    if (!asset) {
+        return createResponse(404, "text/html", 
+            "<h1>404 Not Found</h1><p>The requested file was not found.</p>");
+    }
+    
+    // Prefer brotli, then gzip, when the client accepts them
+    StrView acceptEncoding = findHeader(req, "Accept-Encoding");
+    shared_ptr<const string> body = asset->content;
+    const string* etag = &asset->etag;
+    const char* encoding = nullptr;
+    if (asset->brotli && acceptEncoding.containsIgnoreCase("br")) {
+        body = asset->brotli;
+        etag = &asset->brotliEtag;
+        encoding = "br";
+    } else if (asset->gzip && acceptEncoding.containsIgnoreCase("gzip")) {
+        body = asset->gzip;
+        etag = &asset->gzipEtag;
+        encoding = "gzip";
+    }
+    
+    stringstream headers;
+    headers << "ETag: " << *etag << "\r\n";
+    headers << "Cache-Control: " << staticAssets().getCacheControl() << "\r\n";
+    if (asset->gzip || asset->brotli) headers << "Vary: Accept-Encoding\r\n";
+    if (encoding) headers << "Content-Encoding: " << encoding << "\r\n";
+    
+    if (etagMatches(findHeader(req, "If-None-Match"), *etag)) {
+        return createResponse(304, asset->contentType, "", headers.str());
+    }
+    
+    HttpResponse response = createResponse(200, asset->contentType, "", headers.str());
+    if (body) {
+        response.sharedBody = body;
+    } else {
+        response.filePath = asset->filePath;
+        response.fileLength = asset->file.size;
+    }
+    return response;
+}
+
+// Encode and decode are CPU-bound and go to the worker pool; everything else
+// is answered on the I/O thread that read the request
+bool isComputeRoute(const HttpRequest& req) {
+    return req.method == "POST" && (req.path == "/api/encode" || req.path == "/api/decode" ||
+                                    req.path == "/api/compress" || req.path == "/api/decompress" ||
+                                    req.path == "/api/encode/batch" || req.path == "/api/decode/batch");
+}
+
+HttpResponse routeRequest(const HttpRequest& req) {
+    // Handle OPTIONS (CORS preflight)
+    if (req.method == "OPTIONS") {
+        return createResponse(204, "text/plain", "");
+    }
+    // API Endpoints
+    if (req.path == "/api/status" && req.method == "GET") {
+        return createResponse(200, "application/json", 
+            string("{\"status\":\"running\",\"backend\":\"C++\",\"version\":\"1.0\",\"kernels\":\"") + 
+            codingKernels().name + "\",\"checksum\":\"" + checksumKernels().name + "\"}");
+    }
+    if (req.path == "/api/metrics" && req.method == "GET") {
+        return handleMetricsRequest();
+    }
+    if (req.path == "/api/models" && req.method == "GET") {
+        return handleModelsRequest();
+    }
+    if (req.path == "/api/encode" && req.method == "POST") {
+        return handleCachedEncodeRequest(req);
+    }
+    if (req.path == "/api/decode" && req.method == "POST") {
+        return handleDecodeRequest(req);
+    }
+    if (req.path == "/api/compress" && req.method == "POST") {
+        return handleCompressRequest(req);
+    }
+    if (req.path == "/api/decompress" && req.method == "POST") {
+        return handleDecompressRequest(req);
+    }
+    if (req.path == "/api/encode/batch" && req.method == "POST") {
+        return handleBatchEncodeRequest(req);
+    }
+    if (req.path == "/api/decode/batch" && req.method == "POST") {
+        return handleBatchDecodeRequest(req);
+    }
+    // Serve static files
+    return handleStaticRequest(req);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              CONNECTION I/O
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#ifdef _WIN32
+    typedef WSAPOLLFD PollFd;
+    int pollSockets(PollFd* fds, size_t count, int timeoutMs) {
+        return WSAPoll(fds, (ULONG)count, timeoutMs);
+    }
+#else
+    typedef pollfd PollFd;
+    int pollSockets(PollFd* fds, size_t count, int timeoutMs) {
+        return poll(fds, (nfds_t)count, timeoutMs);
+    }
+#endif
+
+bool setNonBlocking(SOCKET s, bool enabled) {
+#ifdef _WIN32
+    u_long mode = enabled ? 1 : 0;
+    return ioctlsocket(s, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(s, F_GETFL, 0);
+    if (flags < 0) return false;
+    flags = enabled ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return fcntl(s, F_SETFL, flags) == 0;
+#endif
+}
+
+// Bounds how long a stalled peer can hold an I/O or worker thread
+void setSocketTimeouts(SOCKET s, int timeoutMs) {
+#ifdef _WIN32
+    DWORD timeout = (DWORD)timeoutMs;
+#else
+    timeval timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_usec = (timeoutMs % 1000) * 1000;
+#endif
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+}
+
+void setNoDelay(SOCKET s) {
+    int enabled = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&enabled, sizeof(enabled));
+}
+
+static const size_t kMaxHeadSize = 65536;       // request line plus headers
+
+/**
+ * Per-request limits, set from the command line (see ServerOptions).
+ * Buffered bodies over maxBodyBytes get a 413 before they are read;
+ * streaming routes are exempt since they never hold a whole body. A
+ * request whose head and body take longer than ioTimeoutMs to arrive gets
+ * a 408, which also bounds clients that trickle bytes just fast enough to
+ * beat the per-read socket timeout of the same length.
+ */
+struct RequestLimits {
+    size_t maxBodyBytes;
+    size_t largeRequestBytes;   // bodies from this size run in the large lane
+    int ioTimeoutMs;            // per socket read or write, and per request
+    
+    RequestLimits() : maxBodyBytes(1048576), largeRequestBytes(65536), ioTimeoutMs(30000) {}
+};
+
+/**
+ * A client socket that may carry many requests. Bytes received past the end
+ * of one request (pipelining) stay in `buffer` for the next one. The socket
+ * is closed when the last reference goes away.
+ */
+struct Connection {
+    SOCKET socket;
+    string buffer;
+    unsigned requestsServed;
+    bool registered;            // known to the epoll set (loop thread only)
+    
+    explicit Connection(SOCKET s) : socket(s), requestsServed(0), registered(false) {
+        metrics().openConnections++;
+    }
+    
+    ~Connection() {
+        closesocket(socket);
+        metrics().openConnections--;
+    }
+};
+
+// recv() that feeds the received-bytes counter
+int receive(SOCKET s, char* buffer, size_t capacity) {
+    int bytesReceived = recv(s, buffer, (int)min(capacity, (size_t)1 << 30), 0);
+    if (bytesReceived > 0) recordBytesReceived((size_t)bytesReceived);
+    return bytesReceived;
+}
+
+// The last failed receive() hit the socket timeout rather than a reset
+bool receiveTimedOut() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAETIMEDOUT;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+// Routes that consume their body as it arrives instead of buffering it
+bool isStreamingPath(StrView path) {
+    return path == "/api/encode/stream" || path == "/api/decode/stream";
+}
+
+enum ReadResult {
+    kRequestReady,
+    kConnectionClosed,
+    kRequestTooLarge,
+    kRequestMalformed,
+    kRequestTimedOut
+};
+
+// A complete head is waiting, e.g. the next pipelined request
+bool hasBufferedRequest(const Connection& connection) {
+    return connection.buffer.find("\r\n\r\n") != string::npos;
+}
+
+/**
+ * Reads the next request off the connection. The head is parsed once, in
+ * place in the receive buffer. When the buffer holds exactly one request (no
+ * pipelining) it is moved into the request without copying; otherwise it is
+ * split off. Chunked uploads and streaming routes only get their head read
+ * and bodyFollows set - a BodyReader consumes the body from the connection.
+ * Everything read here has to arrive before `deadline`.
+ */
+ReadResult readRequest(Connection& connection, HttpRequest& req, bool& bodyFollows,
+                       const RequestLimits& limits, MetricsClock::time_point deadline) {
+    MetricsClock::time_point readStart = MetricsClock::now();
+    char buffer[16384];
+    string& pending = connection.buffer;
+    size_t scanned = 0;
+    size_t headerEnd;
+    while ((headerEnd = pending.find("\r\n\r\n", scanned)) == string::npos) {
+        if (pending.length() > kMaxHeadSize) return kRequestTooLarge;
+        if (MetricsClock::now() > deadline) return kRequestTimedOut;
+        scanned = pending.length() < 3 ? 0 : pending.length() - 3;
+        
+        int bytesReceived = receive(connection.socket, buffer, sizeof(buffer));
+        if (bytesReceived < 0 && receiveTimedOut() && !pending.empty()) return kRequestTimedOut;
+        if (bytesReceived <= 0) return kConnectionClosed;
+        pending.append(buffer, bytesReceived);
+    }
+    
+    size_t headLength = headerEnd + 4;
+    const char* parsedAt = pending.data();
+    MetricsClock::time_point parseStart = MetricsClock::now();
+    if (!parseRequestHead(parsedAt, headLength, req)) return kRequestMalformed;
+    recordStage(kStageParse, parseStart);
+    
+    bodyFollows = req.chunked || isStreamingPath(req.path);
+    uint64_t bodyLength = bodyFollows ? 0 : req.contentLength;
+    if (headLength > kMaxHeadSize || bodyLength > limits.maxBodyBytes) return kRequestTooLarge;
+    size_t total = headLength + (size_t)bodyLength;
+    
+    if (pending.length() == total) {
+        req.raw.swap(pending);
+    } else if (pending.length() > total) {
+        req.raw.assign(pending, 0, total);
+    } else {
+        // Body still in flight: it goes straight into its own buffer
+        req.raw.assign(pending, 0, headLength);
+        req.bodyStorage.resize((size_t)bodyLength);
+        size_t received = pending.length() - headLength;
+        memcpy(&req.bodyStorage[0], pending.data() + headLength, received);
+        while (received < bodyLength) {
+            if (MetricsClock::now() > deadline) return kRequestTimedOut;
+            int bytesReceived = receive(connection.socket, &req.bodyStorage[received], 
+                                        (size_t)bodyLength - received);
+            if (bytesReceived < 0 && receiveTimedOut()) return kRequestTimedOut;
+            if (bytesReceived <= 0) return kConnectionClosed;
+            received += bytesReceived;
+        }
+    }
+    
+    rebaseRequestHead(req, parsedAt, headLength, req.raw.data());
+    pending.erase(0, min(pending.length(), total));
+    req.body = req.raw.length() > headLength 
+        ? StrView(req.raw.data() + headLength, req.raw.length() - headLength)
+        : StrView(req.bodyStorage);
+    recordStage(kStageRecv, readStart);
+    return kRequestReady;
+}
+
+// HTTP/1.1 connections persist unless the client says otherwise; 1.0
+// clients have to ask
+bool wantsKeepAlive(const HttpRequest& req) {
+    StrView connection = findHeader(req, "Connection");
+    if (req.version == "HTTP/1.0") {
+        return connection.containsIgnoreCase("keep-alive");
+    }
+    return !connection.containsIgnoreCase("close");
+}
+
+// send() may write only part of a large response
+bool sendAll(SOCKET clientSocket, const char* data, size_t length) {
+    size_t sent = 0;
+    while (sent < length) {
+        size_t chunk = min(length - sent, (size_t)1 << 30);
+        int n = send(clientSocket, data + sent, (int)chunk, 0);
+        if (n <= 0) return false;
+        sent += n;
+    }
+    recordBytesSent(length);
+    return true;
+}
+
+/**
+ * Sends length bytes of a file without reading it into user space where the
+ * platform allows: sendfile() on Linux, TransmitFile on Windows (looked up
+ * through WSAIoctl so no extra import library is needed). Elsewhere the file
+ * is copied through a fixed buffer.
+ */
+bool sendFile(SOCKET clientSocket, const string& path, uint64_t length) {
+#if defined(__linux__)
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    off_t offset = 0;
+    bool ok = true;
+    while (ok && (uint64_t)offset < length) {
+        size_t chunk = (size_t)min(length - (uint64_t)offset, (uint64_t)1 << 30);
+        ssize_t n = sendfile(clientSocket, fd, &offset, chunk);
+        ok = n > 0;
+        if (ok) recordBytesSent((size_t)n);
+    }
+    close(fd);
+    return ok;
+#elif defined(_WIN32)
+    static LPFN_TRANSMITFILE transmitFile = nullptr;
+    if (!transmitFile) {
+        GUID guid = WSAID_TRANSMITFILE;
+        DWORD bytes = 0;
+        if (WSAIoctl(clientSocket, SIO_GET_EXTENSION_FUNCTION_POINTER, &guid, sizeof(guid),
+                     &transmitFile, sizeof(transmitFile), &bytes, nullptr, nullptr) != 0) {
+            transmitFile = nullptr;
+        }
+    }
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    bool ok = transmitFile != nullptr;
+    uint64_t offset = 0;
+    while (ok && offset < length) {
+        DWORD chunk = (DWORD)min(length - offset, (uint64_t)1 << 30);
+        LARGE_INTEGER position;
+        position.QuadPart = (LONGLONG)offset;
+        ok = SetFilePointerEx(file, position, nullptr, FILE_BEGIN) &&
+             transmitFile(clientSocket, file, chunk, 0, nullptr, nullptr, 0);
+        if (ok) recordBytesSent(chunk);
+        offset += chunk;
+    }
+    CloseHandle(file);
+    return ok;
+#else
+    ifstream file(path.c_str(), ios::binary);
+    if (!file) return false;
+    vector<char> buffer(65536);
+    uint64_t remaining = length;
+    while (remaining > 0) {
+        size_t chunk = (size_t)min(remaining, (uint64_t)buffer.size());
+        if (!file.read(buffer.data(), chunk)) return false;
+        if (!sendAll(clientSocket, buffer.data(), chunk)) return false;
+        remaining -= chunk;
+    }
+    return true;
+#endif
+}
+
+// Small bodies go out in the same send as the headers; large ones are not
+// copied behind them
+bool sendResponse(SOCKET clientSocket, const HttpResponse& response, bool keepAlive) {
+    string head = formatResponseHead(response, keepAlive);
+    if (response.status == 304) {
+        return sendAll(clientSocket, head.data(), head.length());
+    }
+    if (!response.filePath.empty()) {
+        return sendAll(clientSocket, head.data(), head.length()) &&
+               sendFile(clientSocket, response.filePath, response.fileLength);
+    }
+    
+    const string& body = response.sharedBody ? *response.sharedBody : response.body;
+    if (body.length() <= 16384) {
+        head += body;
+        return sendAll(clientSocket, head.data(), head.length());
+    }
+    return sendAll(clientSocket, head.data(), head.length()) &&
+           sendAll(clientSocket, body.data(), body.length());
+}
+
+/**
+ * Incremental request body, either Content-Length or chunked. Bytes already
+ * buffered on the connection are used first; after that reads go straight
+ * from the socket into the caller's buffer.
+ */
+class BodyReader {
+private:
+    Connection& connection;
+    bool chunked;
+    uint64_t remaining;         // in the current chunk, or in the whole body
+    bool finished;              // all of the body (and any trailer) consumed
+    bool broken;                // peer closed, timed out or sent bad framing
+    bool timedOut;              // broken because the body missed its deadline
+    bool hasDeadline;
+    MetricsClock::time_point deadline;
+    
+    // receive() that also fails once the deadline has passed
+    int receiveBody(char* out, size_t capacity) {
+        if (hasDeadline && MetricsClock::now() > deadline) {
+            timedOut = true;
+            return -1;
+        }
+        int bytesReceived = receive(connection.socket, out, capacity);
+        if (bytesReceived < 0 && receiveTimedOut()) timedOut = true;
+        return bytesReceived;
+    }
+    
+    bool receiveMore() {
+        char buffer[16384];
+        int bytesReceived = receiveBody(buffer, sizeof(buffer));
+        if (bytesReceived <= 0) return false;
+        connection.buffer.append(buffer, bytesReceived);
+        return true;
+    }
+    
+    bool readLine(string& line) {
+        while (true) {
+            size_t end = connection.buffer.find("\r\n");
+            if (end != string::npos) {
+                line.assign(connection.buffer, 0, end);
+                connection.buffer.erase(0, end + 2);
+                return true;
+            }
+            if (connection.buffer.length() > 4096 || !receiveMore()) return false;
+        }
+    }
+    
+    // Reads a chunk-size line; after the last chunk also the trailer
+    bool nextChunk() {
+        string line;
+        if (!readLine(line)) return false;
+        char* end;
+        remaining = strtoull(line.c_str(), &end, 16);
+        if (end == line.c_str()) return false;
+        
+        if (remaining == 0) {
+            do {
+                if (!readLine(line)) return false;
+            } while (!line.empty());
+            finished = true;
+        }
+        return true;
+    }
+    
+public:
+    BodyReader(Connection& conn, const HttpRequest& req)
+        : connection(conn), chunked(req.chunked), remaining(req.chunked ? 0 : req.contentLength),
+          finished(false), broken(false), timedOut(false), hasDeadline(false) {}
+    
+    // A buffered body must arrive in full by 'until'
+    BodyReader(Connection& conn, const HttpRequest& req, MetricsClock::time_point until)
+        : connection(conn), chunked(req.chunked), remaining(req.chunked ? 0 : req.contentLength),
+          finished(false), broken(false), timedOut(false), hasDeadline(true), deadline(until) {}
+    
+    // Up to 'capacity' bytes of body; 0 at the end of the body or on error
+    size_t read(char* out, size_t capacity) {
+        while (!finished && !broken && capacity > 0) {
+            if (remaining == 0) {
+                if (!chunked) {
+                    finished = true;
+                } else if (!nextChunk()) {
+                    broken = true;
+                }
+                continue;
+            }
+            
+            size_t wanted = (size_t)min(remaining, (uint64_t)capacity);
+            size_t got;
+            if (!connection.buffer.empty()) {
+                got = min(wanted, connection.buffer.length());
+                memcpy(out, connection.buffer.data(), got);
+                connection.buffer.erase(0, got);
+            } else {
+                int bytesReceived = receiveBody(out, wanted);
+                if (bytesReceived <= 0) {
+                    broken = true;
+                    break;
+                }
+                got = bytesReceived;
+            }
+            
+            remaining -= got;
+            if (chunked && remaining == 0) {
+                string line;
+                if (!readLine(line) || !line.empty()) broken = true;
+            }
+            return got;
+        }
+        return 0;
+    }
+    
+    // Fills 'length' bytes unless the body ends first
+    size_t readFull(char* out, size_t length) {
+        size_t total = 0;
+        while (total < length) {
+            size_t n = read(out + total, length - total);
+            if (n == 0) break;
+            total += n;
+        }
+        return total;
+    }
+    
+    ReadResult readAll(string& body, size_t limit) {
+        char buffer[16384];
+        while (true) {
+            size_t n = read(buffer, sizeof(buffer));
+            if (n == 0) return timedOut ? kRequestTimedOut : broken ? kConnectionClosed : kRequestReady;
+            if (body.length() + n > limit) return kRequestTooLarge;
+            body.append(buffer, n);
+        }
+    }
+    
+    // Discards whatever is left so the connection can carry another request
+    void skipRest() {
+        char buffer[16384];
+        while (read(buffer, sizeof(buffer)) > 0) {}
+    }
+    
+    bool failed() const {
+        return broken;
+    }
+    
+    bool complete() const {
+        return finished && !broken;
+    }
+};
+
+// Response body of unknown length, sent as HTTP/1.1 chunks
+class ChunkedWriter {
+private:
+    SOCKET socket;
+    bool healthy;
+    
+public:
+    explicit ChunkedWriter(SOCKET s) : socket(s), healthy(true) {}
+    
+    bool write(const string& data) {
+        if (!healthy || data.empty()) return healthy;
+        char size[24];
+        snprintf(size, sizeof(size), "%llx\r\n", (unsigned long long)data.length());
+        
+        string chunk;
+        chunk.reserve(strlen(size) + data.length() + 2);
+        chunk += size;
+        chunk += data;
+        chunk += "\r\n";
+        healthy = sendAll(socket, chunk.data(), chunk.length());
+        return healthy;
+    }
+    
+    // Without this the client sees a truncated response
+    bool finish() {
+        if (healthy) healthy = sendAll(socket, "0\r\n\r\n", 5);
+        return healthy;
+    }
+    
+    bool ok() const {
+        return healthy;
+    }
+};
+
+void logRequest(const HttpRequest& req) {
+    if (!logger().enabled(kLogInfo)) return;
+    LogLine line(kLogInfo);
+    line << "[" << getTimestamp() << "] " << req.method << " " << req.path;
+    if (req.contentLength > 0) {
+        line << " (Content-Length: " << req.contentLength << ", received: " << req.body.length() << ")";
+    }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              EVENT LOOP
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Half-sync/half-async server core. One loop thread waits for readiness on
+ * the listening socket and on idle connections - epoll on Linux, poll()
+ * elsewhere (WSAPoll on Windows). A connection is handed to the I/O pool only
+ * once it has data, so idle or slow clients never occupy a thread. The I/O
+ * threads read and parse requests and serve static files directly; encode and
+ * decode jobs move on to the worker pool, so page loads never queue behind a
+ * large compression job.
+ *
+ * After a response on a kept-alive connection the pool thread hands it back
+ * with resume(); the loop re-arms it and closes it once it has been idle for
+ * the keep-alive timeout. A loopback UDP socket connected to itself wakes the
+ * loop for this on every platform.
+ *
+ * Define HUFFMAN_USE_POLL to use the poll() backend on Linux as well.
+ */
+#if defined(__linux__) && !defined(HUFFMAN_USE_POLL)
+    #define HUFFMAN_USE_EPOLL 1
+#endif
+
+class EventLoop;
+void handleClient(shared_ptr<Connection> connection, EventLoop& loop);
+
+class EventLoop {
 private:
-    HuffmanNode* root;
-    unordered_map<char, string> huffmanCodes;
-    unordered_map<char, int> frequencies;
-    string lastEncodedText;  // Store original text for verification
+    typedef chrono::steady_clock Clock;
     
-    void buildCodes(HuffmanNode* node, const string& code) {
-        if (!node) return;
+    struct IdleConnection {
+        shared_ptr<Connection> connection;
+        Clock::time_point since;
+    };
+    
+    SOCKET listener;
+    SOCKET wakeSocket;
+    ThreadPool& ioPool;
+    WorkerPool& workers;
+    int keepAliveTimeoutMs;
+    unsigned maxRequests;
+    RequestLimits requestLimits;
+    
+    mutex resumeMutex;
+    vector<shared_ptr<Connection> > resumed;        // handed back by pool threads
+    unordered_map<SOCKET, IdleConnection> idle;     // loop thread only
+    Clock::time_point lastSweep;
+#ifdef HUFFMAN_USE_EPOLL
+    int epollFd;
+#endif
+    
+    static SOCKET createWakeSocket() {
+        SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (s == INVALID_SOCKET) return INVALID_SOCKET;
         
-        if (!node->left && !node->right) {
-            huffmanCodes[node->ch] = code.empty() ? "0" : code;
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t addrLen = sizeof(addr);
+        if (bind(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+            getsockname(s, (sockaddr*)&addr, &addrLen) == SOCKET_ERROR ||
+            connect(s, (sockaddr*)&addr, addrLen) == SOCKET_ERROR) {
+            closesocket(s);
+            return INVALID_SOCKET;
         }
-        
-        buildCodes(node->left, code + "0");
-        buildCodes(node->right, code + "1");
+        setNonBlocking(s, true);
+        return s;
     }
     
-    void buildTreeJson(HuffmanNode* node, stringstream& ss, int depth = 0) {
-        if (!node) {
-            ss << "null";
-            return;
-        }
-        
-        ss << "{";
-        ss << "\"freq\":" << node->freq << ",";
-        
-        if (!node->left && !node->right) {
-            ss << "\"char\":";
-            if (node->ch == '"') {
-                ss << "\"\\\"\"";
-            } else if (node->ch == '\\') {
-                ss << "\"\\\\\"";
-            } else if (node->ch == '\n') {
-                ss << "\"\\\\n\"";
-            } else if (node->ch == '\t') {
-                ss << "\"\\\\t\"";
-            } else if (node->ch == '\r') {
-                ss << "\"\\\\r\"";
-            } else if (node->ch == '\b') {
-                ss << "\"\\\\b\"";
-            } else if (node->ch == '\f') {
-                ss << "\"\\\\f\"";
-            } else if (node->ch == ' ') {
-                ss << "\"[space]\"";
-            } else if ((unsigned char)node->ch < 32) {
-                ss << "\"\\\\u" << hex << setfill('0') << setw(4) << (int)(unsigned char)node->ch << dec << "\"";
-            } else {
-                ss << "\"" << node->ch << "\"";
-            }
-        } else {
-            ss << "\"left\":";
-            buildTreeJson(node->left, ss, depth + 1);
-            ss << ",\"right\":";
-            buildTreeJson(node->right, ss, depth + 1);
-        }
-        
-        ss << "}";
+    void wake() {
+        char signal = 0;
+        send(wakeSocket, &signal, 1, 0);
     }
     
-public:
-    HuffmanCoder() : root(nullptr) {}
+    void drainWakeups() {
+        char buffer[64];
+        while (recv(wakeSocket, buffer, sizeof(buffer), 0) > 0) {}
+    }
     
-    ~HuffmanCoder() {
-        if (root) {
-            delete root;
-            root = nullptr;
-        }
+    void dispatch(const shared_ptr<Connection>& connection) {
+        EventLoop* loop = this;
+        ioPool.submit([connection, loop] {
+            try {
+                handleClient(connection, *loop);
+            } catch (const exception& e) {
+                LogLine(kLogError) << "[ERROR] Exception in handleClient: " << e.what();
+            } catch (...) {
+                LogLine(kLogError) << "[ERROR] Unknown exception in handleClient";
+            }
+        });
     }
     
-    void reset() {
-        if (root) {
-            delete root;
-            root = nullptr;
-        }
-        huffmanCodes.clear();
-        frequencies.clear();
-        lastEncodedText.clear();
+    // Waits for the connection's next request (loop thread only)
+    void watch(const shared_ptr<Connection>& connection) {
+        IdleConnection entry;
+        entry.connection = connection;
+        entry.since = Clock::now();
+#ifdef HUFFMAN_USE_EPOLL
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        event.data.fd = connection->socket;
+        int op = connection->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        if (epoll_ctl(epollFd, op, connection->socket, &event) != 0) return;
+        connection->registered = true;
+#endif
+        idle[connection->socket] = entry;
     }
     
-    void calculateFrequencies(const string& text) {
-        frequencies.clear();
-        lastEncodedText = text;  // Store for verification
-        for (size_t i = 0; i < text.length(); i++) {
-            frequencies[text[i]]++;
-        }
+    void onReadable(SOCKET s) {
+        unordered_map<SOCKET, IdleConnection>::iterator it = idle.find(s);
+        if (it == idle.end()) return;
+        shared_ptr<Connection> connection = it->second.connection;
+        idle.erase(it);
+        dispatch(connection);
     }
     
-    void buildTree() {
-        priority_queue<HuffmanNode*, vector<HuffmanNode*>, CompareNode> pq;
-        
-        for (unordered_map<char, int>::iterator it = frequencies.begin(); 
-             it != frequencies.end(); ++it) {
-            pq.push(new HuffmanNode(it->first, it->second));
-        }
-        
-        if (pq.size() == 1) {
-            HuffmanNode* node = pq.top();
-            pq.pop();
-            if (root) delete root;
-            root = new HuffmanNode('\0', node->freq);
-            root->left = node;
-        } else {
-            while (pq.size() > 1) {
-                HuffmanNode* left = pq.top(); pq.pop();
-                HuffmanNode* right = pq.top(); pq.pop();
-                
-                HuffmanNode* parent = new HuffmanNode('\0', left->freq + right->freq);
-                parent->left = left;
-                parent->right = right;
-                
-                pq.push(parent);
-            }
+    // The listener is non-blocking, so drain the whole backlog per wakeup
+    void acceptPending() {
+        while (true) {
+            sockaddr_in clientAddr;
+            socklen_t clientAddrLen = sizeof(clientAddr);
+            SOCKET clientSocket = accept(listener, (sockaddr*)&clientAddr, &clientAddrLen);
+            if (clientSocket == INVALID_SOCKET) return;
             
-            if (root) delete root;
-            if (!pq.empty()) {
-                root = pq.top();
-                pq.pop();
-            } else {
-                root = nullptr;
-            }
+            // Request handling uses blocking reads with a timeout
+            setNonBlocking(clientSocket, false);
+            setSocketTimeouts(clientSocket, requestLimits.ioTimeoutMs);
+            setNoDelay(clientSocket);
+            watch(make_shared<Connection>(clientSocket));
         }
-        
-        huffmanCodes.clear();
-        buildCodes(root, "");
     }
     
-    string encode(const string& text) {
-        if (text.empty() || huffmanCodes.empty()) {
-            return "";
+    void watchResumed() {
+        vector<shared_ptr<Connection> > batch;
+        {
+            lock_guard<mutex> lock(resumeMutex);
+            batch.swap(resumed);
         }
-        
-        string encoded;
-        for (size_t i = 0; i < text.length(); i++) {
-            if (huffmanCodes.find(text[i]) != huffmanCodes.end()) {
-                encoded += huffmanCodes[text[i]];
-            }
+        for (size_t i = 0; i < batch.size(); i++) {
+            watch(batch[i]);
         }
-        return encoded;
     }
     
-    string decode(const string& encoded) {
-        if (!root || encoded.empty()) return "";
-        
-        string decoded;
-        HuffmanNode* current = root;
+    // Erasing the entry drops the last reference and closes the socket
+    void closeIdle() {
+        Clock::time_point now = Clock::now();
+        if (now - lastSweep < chrono::seconds(1)) return;
+        lastSweep = now;
         
-        for (size_t i = 0; i < encoded.length(); i++) {
-            if (!current) {
-                // Invalid state, restart from root
-                current = root;
-                continue;
-            }
-            
-            if (encoded[i] == '0') {
-                if (current->left) {
-                    current = current->left;
-                } else {
-                    // Invalid path, skip
-                    current = root;
-                    continue;
-                }
-            } else if (encoded[i] == '1') {
-                if (current->right) {
-                    current = current->right;
-                } else {
-                    // Invalid path, skip
-                    current = root;
-                    continue;
-                }
-            }
-            
-            if (current && !current->left && !current->right) {
-                decoded += current->ch;
-                current = root;
+        chrono::milliseconds timeout(keepAliveTimeoutMs);
+        for (unordered_map<SOCKET, IdleConnection>::iterator it = idle.begin(); it != idle.end(); ) {
+            if (now - it->second.since >= timeout) {
+                it = idle.erase(it);
+            } else {
+                ++it;
             }
         }
-        
-        return decoded;
     }
     
-    string getLastEncodedText() const {
-        return lastEncodedText;
+public:
+    EventLoop(SOCKET listenSocket, ThreadPool& io, WorkerPool& compute, 
+              int keepAliveTimeout, unsigned maxRequestsPerConnection, const RequestLimits& limits)
+        : listener(listenSocket), wakeSocket(createWakeSocket()), ioPool(io), workers(compute),
+          keepAliveTimeoutMs(keepAliveTimeout), maxRequests(maxRequestsPerConnection),
+          requestLimits(limits), lastSweep(Clock::now()) {
+        setNonBlocking(listener, true);
+#ifdef HUFFMAN_USE_EPOLL
+        epollFd = epoll_create1(0);
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = listener;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, listener, &event);
+        event.data.fd = wakeSocket;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeSocket, &event);
+#endif
     }
     
-    string getFrequenciesJson() {
-        stringstream ss;
-        ss << "{";
-        bool first = true;
-        for (unordered_map<char, int>::iterator it = frequencies.begin(); 
-             it != frequencies.end(); ++it) {
-            if (!first) ss << ",";
-            first = false;
-            
-            string key;
-            if (it->first == '"') key = "\\\"";
-            else if (it->first == '\\') key = "\\\\";
-            else if (it->first == '\n') key = "\\n";
-            else if (it->first == '\t') key = "\\t";
-            else if (it->first == '\r') key = "\\r";
-            else if (it->first == '\b') key = "\\b";
-            else if (it->first == '\f') key = "\\f";
-            else if ((unsigned char)it->first < 32) {
-                char buf[8];
-                sprintf(buf, "\\u%04x", (unsigned char)it->first);
-                key = string(buf);
-            }
-            else key = string(1, it->first);
-            
-            ss << "\"" << key << "\":" << it->second;
-        }
-        ss << "}";
-        return ss.str();
+    ~EventLoop() {
+        idle.clear();
+        if (wakeSocket != INVALID_SOCKET) closesocket(wakeSocket);
+#ifdef HUFFMAN_USE_EPOLL
+        if (epollFd >= 0) close(epollFd);
+#endif
     }
     
-    string getCodesJson() {
-        stringstream ss;
-        ss << "{";
-        bool first = true;
-        for (unordered_map<char, string>::iterator it = huffmanCodes.begin(); 
-             it != huffmanCodes.end(); ++it) {
-            if (!first) ss << ",";
-            first = false;
-            
-            string key;
-            if (it->first == '"') key = "\\\"";
-            else if (it->first == '\\') key = "\\\\";
-            else if (it->first == '\n') key = "\\n";
-            else if (it->first == '\t') key = "\\t";
-            else if (it->first == '\r') key = "\\r";
-            else if (it->first == '\b') key = "\\b";
-            else if (it->first == '\f') key = "\\f";
-            else if ((unsigned char)it->first < 32) {
-                char buf[8];
-                sprintf(buf, "\\u%04x", (unsigned char)it->first);
-                key = string(buf);
-            }
-            else key = string(1, it->first);
-            
-            ss << "\"" << key << "\":\"" << it->second << "\"";
-        }
-        ss << "}";
-        return ss.str();
+    bool valid() const {
+#ifdef HUFFMAN_USE_EPOLL
+        if (epollFd < 0) return false;
+#endif
+        return wakeSocket != INVALID_SOCKET;
+    }
+    
+    static const char* backendName() {
+#ifdef HUFFMAN_USE_EPOLL
+        return "epoll";
+#elif defined(_WIN32)
+        return "WSAPoll";
+#else
+        return "poll";
+#endif
     }
     
-    string getTreeJson() {
-        stringstream ss;
-        buildTreeJson(root, ss);
-        return ss.str();
+    WorkerPool& workerPool() {
+        return workers;
     }
     
-    int getOriginalBits(const string& text) {
-        return text.length() * 8;
+    const RequestLimits& limits() const {
+        return requestLimits;
     }
     
-    int getEncodedBits(const string& encoded) {
-        return encoded.length();
+    unsigned maxRequestsPerConnection() const {
+        return maxRequests;
     }
     
-    double getCompressionRatio(const string& text, const string& encoded) {
-        if (text.empty()) return 0;
-        int original = getOriginalBits(text);
-        int compressed = getEncodedBits(encoded);
-        return ((double)(original - compressed) / original) * 100;
+    // Called from a pool thread once a response has been sent and the
+    // connection stays open. A pipelined request that is already buffered
+    // is handled right away; otherwise the loop waits for more data.
+    void resume(const shared_ptr<Connection>& connection) {
+        if (hasBufferedRequest(*connection)) {
+            dispatch(connection);
+            return;
+        }
+        {
+            lock_guard<mutex> lock(resumeMutex);
+            resumed.push_back(connection);
+        }
+        wake();
     }
     
-    int getUniqueChars() {
-        return frequencies.size();
+    void run() {
+#ifdef HUFFMAN_USE_EPOLL
+        epoll_event events[64];
+        while (true) {
+            int ready = epoll_wait(epollFd, events, 64, 1000);
+            for (int i = 0; i < ready; i++) {
+                SOCKET s = events[i].data.fd;
+                if (s == listener) {
+                    acceptPending();
+                } else if (s == wakeSocket) {
+                    drainWakeups();
+                    watchResumed();
+                } else {
+                    // One-shot: the fd stays disarmed until watch() re-arms it
+                    onReadable(s);
+                }
+            }
+            closeIdle();
+        }
+#else
+        vector<PollFd> fds;
+        while (true) {
+            fds.clear();
+            PollFd entry;
+            entry.events = POLLIN;
+            entry.revents = 0;
+            entry.fd = listener;
+            fds.push_back(entry);
+            entry.fd = wakeSocket;
+            fds.push_back(entry);
+            for (unordered_map<SOCKET, IdleConnection>::iterator it = idle.begin(); it != idle.end(); ++it) {
+                entry.fd = it->first;
+                fds.push_back(entry);
+            }
+            
+            int ready = pollSockets(&fds[0], fds.size(), 1000);
+            if (ready > 0) {
+                for (size_t i = 2; i < fds.size(); i++) {
+                    if (fds[i].revents != 0) onReadable(fds[i].fd);
+                }
+                if (fds[1].revents != 0) {
+                    drainWakeups();
+                    watchResumed();
+                }
+                if (fds[0].revents != 0) acceptPending();
+            }
+            closeIdle();
+        }
+#endif
     }
 };
 
-// Global coder instance
-HuffmanCoder coder;
-
 // ═══════════════════════════════════════════════════════════════════════════════
-//                              HTTP SERVER
+//                              STREAMING ENDPOINTS
 // ═══════════════════════════════════════════════════════════════════════════════
 
-string getContentType(const string& path) {
-    if (path.find(".html") != string::npos) return "text/html; charset=utf-8";
-    if (path.find(".css") != string::npos) return "text/css; charset=utf-8";
-    if (path.find(".js") != string::npos) return "application/javascript; charset=utf-8";
-    if (path.find(".json") != string::npos) return "application/json; charset=utf-8";
-    if (path.find(".png") != string::npos) return "image/png";
-    if (path.find(".ico") != string::npos) return "image/x-icon";
-    return "text/plain; charset=utf-8";
+/**
+ * /api/encode/stream and /api/decode/stream convert between raw bytes and a
+ * HUFS stream without holding either in memory. The body is read a batch of
+ * blocks at a time, the batch is coded on the coding pool, and the result is
+ * sent back as chunks before the next batch is read. Memory per request stays
+ * near kStreamBatchBytes whatever the input size.
+ */
+static const size_t kStreamBatchBytes = 32 * 1024 * 1024;
+
+static size_t streamBatchBlocks() {
+    return max((size_t)1, codingPool().size());
 }
 
-string readFile(const string& path) {
-    ifstream file(path.c_str(), ios::binary);
-    if (!file.is_open()) return "";
-    
-    stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+bool isStreamingRoute(const HttpRequest& req) {
+    return req.method == "POST" && isStreamingPath(req.path);
 }
 
-struct HttpRequest {
-    string method;
-    string path;
-    string body;
-    unordered_map<string, string> headers;
-    int contentLength;
-};
+// Error reply sent before any output. The rest of the request body is left
+// unread, so the connection is not reused.
+static void rejectStream(const shared_ptr<Connection>& connection, const HttpRequest& req,
+                         int status, const string& error) {
+    recordRequest(routeOf(req), status);
+    LogLine(kLogWarn) << "  [STREAM] ERROR: " << error;
+    sendResponse(connection->socket, errorResponse(status, error), false);
+}
 
-HttpRequest parseRequest(const string& rawRequest) {
-    HttpRequest req;
-    req.contentLength = 0;
-    istringstream stream(rawRequest);
-    string line;
+static bool sendStreamHead(const shared_ptr<Connection>& connection, bool keepAlive) {
+    HttpResponse head = createResponse(200, "application/octet-stream", "");
+    head.chunked = true;
+    return sendResponse(connection->socket, head, keepAlive);
+}
+
+// A failure after the head went out can only be reported by dropping the
+// connection before the final chunk
+void handleEncodeStream(const shared_ptr<Connection>& connection, const HttpRequest& req,
+                        bool keepAlive, EventLoop& loop) {
+    FrameOptions options;
+    string error;
+    if (req.version == "HTTP/1.0") {
+        rejectStream(connection, req, 400, "Streaming needs HTTP/1.1 (chunked responses)");
+        return;
+    }
+    if (!parseCodingOptions(req, options, error)) {
+        rejectStream(connection, req, 400, error);
+        return;
+    }
+    // Stream blocks carry their own tables, which is negligible at this size
+    if (options.model) {
+        rejectStream(connection, req, 400, "model= is not supported on streams");
+        return;
+    }
     
-    // Parse request line
-    if (getline(stream, line)) {
-        // Remove trailing \r
-        if (!line.empty() && line[line.length()-1] == '\r') {
-            line = line.substr(0, line.length()-1);
+    BodyReader body(*connection, req);
+    if (!sendStreamHead(connection, keepAlive)) return;
+    ChunkedWriter writer(connection->socket);
+    writer.write(encodeStreamHeader(options.interleaved, options.checksum));
+    
+    size_t batchBlocks = max((size_t)1, min(streamBatchBlocks(), kStreamBatchBytes / options.blockSize));
+    vector<string> blocks(batchBlocks);
+    vector<string> records(batchBlocks);
+    uint64_t totalIn = 0;
+    uint64_t totalOut = kStreamHeaderSize;
+    bool more = true;
+    
+    while (more && writer.ok()) {
+        size_t filled = 0;
+        while (filled < batchBlocks) {
+            string& block = blocks[filled];
+            block.resize(options.blockSize);
+            block.resize(body.readFull(&block[0], options.blockSize));
+            if (!block.empty()) filled++;
+            if (block.length() < options.blockSize) {
+                more = false;
+                break;
+            }
         }
-        istringstream lineStream(line);
-        lineStream >> req.method >> req.path;
+        if (body.failed()) break;
         
-        // Strip query string from path
-        size_t queryPos = req.path.find('?');
-        if (queryPos != string::npos) {
-            req.path = req.path.substr(0, queryPos);
+        codingPool().parallelFor(filled, [&](size_t b) {
+            records[b].clear();
+            encodeStreamBlock(blocks[b].data(), blocks[b].length(), options.maxCodeLength,
+                              options.interleaved, options.checksum, records[b]);
+        });
+        for (size_t b = 0; b < filled; b++) {
+            totalIn += blocks[b].length();
+            totalOut += records[b].length();
+            writer.write(records[b]);
         }
     }
     
-    // Parse headers
-    while (getline(stream, line)) {
-        // Remove trailing \r
-        if (!line.empty() && line[line.length()-1] == '\r') {
-            line = line.substr(0, line.length()-1);
+    if (!body.complete() || !writer.ok()) {
+        LogLine(kLogWarn) << "  [ENCODE] Stream aborted after " << totalIn << " bytes";
+        return;
+    }
+    
+    string end;
+    encodeStreamBlock(nullptr, 0, options.maxCodeLength, options.interleaved, options.checksum, end);
+    writer.write(end);
+    if (!writer.finish()) return;
+    recordRequest(kRouteEncodeStream, 200);
+    
+    LogLine(kLogDebug) << "  [ENCODE] Streamed " << totalIn << " bytes into " << totalOut + end.length() << " bytes";
+    if (keepAlive) loop.resume(connection);
+}
+
+void handleDecodeStream(const shared_ptr<Connection>& connection, const HttpRequest& req,
+                        bool keepAlive, EventLoop& loop) {
+    if (req.version == "HTTP/1.0") {
+        rejectStream(connection, req, 400, "Streaming needs HTTP/1.1 (chunked responses)");
+        return;
+    }
+    
+    BodyReader body(*connection, req);
+    char header[kStreamHeaderSize];
+    bool interleaved = false;
+    bool checksum = false;
+    string error;
+    if (body.readFull(header, kStreamHeaderSize) != kStreamHeaderSize) {
+        error = "Truncated stream header";
+    } else {
+        parseStreamHeader(header, interleaved, checksum, error);
+    }
+    if (!error.empty()) {
+        rejectStream(connection, req, 400, error);
+        return;
+    }
+    
+    // The head waits for the first batch so an invalid stream still gets a 400
+    ChunkedWriter writer(connection->socket);
+    bool headSent = false;
+    size_t batchBlocks = streamBatchBlocks();
+    vector<string> payloads(batchBlocks);
+    vector<string> outputs(batchBlocks);
+    vector<uint32_t> checksums(batchBlocks);
+    vector<char> blockOk(batchBlocks);
+    size_t recordHeaderSize = streamRecordHeaderSize(checksum);
+    uint64_t blockIndex = 0;
+    uint64_t totalOut = 0;
+    bool ended = false;
+    
+    while (!ended && error.empty()) {
+        size_t count = 0;
+        size_t batchBytes = 0;
+        while (count < batchBlocks && batchBytes < kStreamBatchBytes) {
+            char record[kStreamBlockHeaderSize + kFrameChecksumSize];
+            if (body.readFull(record, recordHeaderSize) != recordHeaderSize) {
+                error = "Truncated stream";
+                break;
+            }
+            uint32_t rawSize = getU32(record);
+            uint32_t payloadSize = getU32(record + 4);
+            if (rawSize == 0) {
+                ended = true;
+                break;
+            }
+            if (!validStreamBlock(rawSize, payloadSize)) {
+                stringstream message;
+                message << "Block " << blockIndex + count << " has an invalid size";
+                error = message.str();
+                break;
+            }
+            
+            payloads[count].resize(payloadSize);
+            if (body.readFull(&payloads[count][0], payloadSize) != payloadSize) {
+                error = "Truncated stream";
+                break;
+            }
+            outputs[count].assign(rawSize, '\0');
+            if (checksum) checksums[count] = getU32(record + kStreamBlockHeaderSize);
+            batchBytes += rawSize;
+            count++;
         }
-        if (line.empty()) break;
         
-        size_t colonPos = line.find(':');
-        if (colonPos != string::npos) {
-            string key = line.substr(0, colonPos);
-            string value = line.substr(colonPos + 1);
-            // Trim leading whitespace from value
-            while (!value.empty() && (value[0] == ' ' || value[0] == '\t')) {
-                value = value.substr(1);
+        codingPool().parallelFor(count, [&](size_t b) {
+            blockOk[b] = decodeBlockPayload(payloads[b].data(), payloads[b].length(), interleaved,
+                                            &outputs[b][0], outputs[b].length());
+            if (blockOk[b] && checksum && crc32c(outputs[b].data(), outputs[b].length()) != checksums[b]) {
+                blockOk[b] = kBlockChecksumMismatch;
             }
-            req.headers[key] = value;
-            
-            // Parse Content-Length
-            if (key == "Content-Length") {
-                req.contentLength = atoi(value.c_str());
+        });
+        size_t good = 0;
+        while (good < count && blockOk[good] == 1) good++;
+        if (good < count) {
+            error = blockError(blockIndex + good, blockOk[good]);
+        }
+        
+        if (!headSent) {
+            if (!error.empty()) {
+                rejectStream(connection, req, 400, error);
+                return;
             }
+            if (!sendStreamHead(connection, keepAlive)) return;
+            headSent = true;
+        }
+        for (size_t b = 0; b < good; b++) {
+            totalOut += outputs[b].length();
+            writer.write(outputs[b]);
         }
+        blockIndex += count;
     }
     
-    // Parse body - respect Content-Length
-    size_t bodyStart = rawRequest.find("\r\n\r\n");
-    if (bodyStart != string::npos) {
-        string fullBody = rawRequest.substr(bodyStart + 4);
-        if (req.contentLength > 0 && req.contentLength <= (int)fullBody.length()) {
-            req.body = fullBody.substr(0, req.contentLength);
-        } else {
-            req.body = fullBody;
-        }
+    if (!error.empty() || !writer.ok()) {
+        LogLine(kLogWarn) << "  [DECODE] Stream aborted after " << totalOut << " bytes: " << error;
+        return;
     }
+    if (!writer.finish()) return;
+    recordRequest(kRouteDecodeStream, 200);
     
-    return req;
+    LogLine(kLogDebug) << "  [DECODE] Streamed " << blockIndex << " blocks into " << totalOut << " bytes";
+    body.skipRest();
+    if (keepAlive && body.complete()) loop.resume(connection);
 }
 
-string createResponse(int status, const string& contentType, const string& body) {
-    stringstream response;
-    response << "HTTP/1.1 " << status << " ";
-    
-    switch (status) {
-        case 200: response << "OK"; break;
-        case 204: response << "No Content"; break;
-        case 400: response << "Bad Request"; break;
-        case 404: response << "Not Found"; break;
-        case 500: response << "Internal Server Error"; break;
-        default: response << "Unknown"; break;
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              CONNECTION HANDLING
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Runs the route and writes the reply. A throwing handler becomes a 500
+// rather than unwinding out of a pool thread.
+void respond(const shared_ptr<Connection>& connection, const HttpRequest& req, 
+             bool keepAlive, EventLoop& loop, MetricsClock::time_point receivedAt) {
+    HttpResponse response;
+    try {
+        response = routeRequest(req);
+    } catch (const exception& e) {
+        LogLine(kLogError) << "[ERROR] Exception handling " << req.path << ": " << e.what();
+        response = errorResponse(500, "Internal server error");
+    } catch (...) {
+        LogLine(kLogError) << "[ERROR] Unknown exception handling " << req.path;
+        response = errorResponse(500, "Internal server error");
     }
     
-    response << "\r\n";
-    response << "Content-Type: " << contentType << "\r\n";
-    response << "Content-Length: " << body.length() << "\r\n";
-    response << "Access-Control-Allow-Origin: *\r\n";
-    response << "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n";
-    response << "Access-Control-Allow-Headers: Content-Type\r\n";
-    response << "Connection: close\r\n";
-    response << "\r\n";
-    response << body;
+    MetricsClock::time_point sendStart = MetricsClock::now();
+    bool sent = sendResponse(connection->socket, response, keepAlive);
+    recordStage(kStageSend, sendStart);
+    recordStage(kStageTotal, receivedAt);
+    recordRequest(routeOf(req), response.status);
     
-    return response.str();
+    if (sent && keepAlive) {
+        loop.resume(connection);
+    }
 }
 
-string getTimestamp() {
-    time_t now = time(0);
-    tm* ltm = localtime(&now);
-    char buffer[32];
-    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", ltm);
-    return string(buffer);
+// The connection is closed after these: the rest of the request is unread
+static void rejectRequest(const shared_ptr<Connection>& connection, const HttpRequest& req, 
+                          ReadResult result, const RequestLimits& limits) {
+    if (result == kRequestTimedOut) {
+        recordRequest(routeOf(req), 408);
+        sendResponse(connection->socket, errorResponse(408, "Request not received in time"), false);
+        return;
+    }
+    stringstream message;
+    message << "Request too large - bodies are limited to " << limits.maxBodyBytes 
+            << " bytes, headers to " << kMaxHeadSize;
+    recordRequest(routeOf(req), 413);
+    sendResponse(connection->socket, errorResponse(413, message.str()), false);
 }
 
-// Helper function to escape string for JSON
-string escapeJsonString(const string& input) {
-    stringstream ss;
-    for (size_t i = 0; i < input.length(); i++) {
-        char c = input[i];
-        switch (c) {
-            case '"':  ss << "\\\""; break;
-            case '\\': ss << "\\\\"; break;
-            case '\n': ss << "\\n"; break;
-            case '\r': ss << "\\r"; break;
-            case '\t': ss << "\\t"; break;
-            case '\b': ss << "\\b"; break;
-            case '\f': ss << "\\f"; break;
-            default:
-                if ((unsigned char)c < 32) {
-                    char buf[8];
-                    sprintf(buf, "\\u%04x", (unsigned char)c);
-                    ss << buf;
-                } else {
-                    ss << c;
-                }
-        }
+/**
+ * A full lane queue: 503 when it is the small lane, since then the whole
+ * server is saturated, and 429 for the large lane, where the client should
+ * pace its big jobs. Both carry Retry-After. The body has been read, so
+ * the connection can stay open.
+ */
+static void rejectBusy(const shared_ptr<Connection>& connection, const HttpRequest& req, WorkLane lane,
+                       bool keepAlive, EventLoop& loop) {
+    int status = lane == kLaneLarge ? 429 : 503;
+    LogLine(kLogWarn) << "  [ADMISSION] " << kLaneNames[lane] << " lane full, " << status
+                      << " for " << req.path;
+    recordRequest(routeOf(req), status);
+    HttpResponse response = errorResponse(status, lane == kLaneLarge
+        ? "Too many large requests queued - retry later"
+        : "Server busy - retry later", "Retry-After: 1\r\n");
+    if (sendResponse(connection->socket, response, keepAlive) && keepAlive) {
+        loop.resume(connection);
     }
-    return ss.str();
 }
 
-void handleClient(SOCKET clientSocket) {
-    string rawRequest;
-    char buffer[4096];
-    int totalReceived = 0;
-    bool headersComplete = false;
-    int contentLength = 0;
-    size_t bodyStartPos = 0;
+// Called on an I/O thread once the connection has data
+void handleClient(shared_ptr<Connection> connection, EventLoop& loop) {
+    shared_ptr<HttpRequest> req = make_shared<HttpRequest>();
+    bool bodyFollows = false;
+    const RequestLimits& limits = loop.limits();
+    MetricsClock::time_point deadline = MetricsClock::now() + chrono::milliseconds(limits.ioTimeoutMs);
+    ReadResult result = readRequest(*connection, *req, bodyFollows, limits, deadline);
+    if (result == kRequestTooLarge || result == kRequestTimedOut) {
+        rejectRequest(connection, *req, result, limits);
+        return;
+    }
+    if (result == kRequestMalformed) {
+        recordRequest(kRouteStatic, 400);
+        sendResponse(connection->socket, errorResponse(400, "Malformed request"), false);
+        return;
+    }
+    if (result != kRequestReady) return;
+    MetricsClock::time_point receivedAt = MetricsClock::now();
     
-    // Read data until we have all of it
-    while (totalReceived < 1048576) { // Max 1MB
-        int bytesReceived = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-        if (bytesReceived <= 0) break;
-        
-        buffer[bytesReceived] = '\0';
-        rawRequest.append(buffer, bytesReceived);
-        totalReceived += bytesReceived;
-        
-        // Check if headers are complete
-        if (!headersComplete) {
-            size_t headerEnd = rawRequest.find("\r\n\r\n");
-            if (headerEnd != string::npos) {
-                headersComplete = true;
-                bodyStartPos = headerEnd + 4;
-                
-                // Extract Content-Length
-                size_t clPos = rawRequest.find("Content-Length:");
-                if (clPos == string::npos) clPos = rawRequest.find("content-length:");
-                if (clPos != string::npos) {
-                    size_t clEnd = rawRequest.find("\r\n", clPos);
-                    if (clEnd != string::npos) {
-                        string clValue = rawRequest.substr(clPos + 15, clEnd - clPos - 15);
-                        while (!clValue.empty() && (clValue[0] == ' ' || clValue[0] == '\t')) {
-                            clValue = clValue.substr(1);
-                        }
-                        contentLength = atoi(clValue.c_str());
-                    }
+    connection->requestsServed++;
+    bool keepAlive = wantsKeepAlive(*req) && connection->requestsServed < loop.maxRequestsPerConnection();
+    logRequest(*req);
+    
+    EventLoop* owner = &loop;
+    if (isStreamingRoute(*req)) {
+        // A stream holds its worker for as long as the transfer lasts
+        bool queued = loop.workerPool().trySubmit(kLaneLarge, [connection, req, keepAlive, owner, receivedAt] {
+            recordStage(kStageQueue, receivedAt);
+            try {
+                if (req->path == "/api/encode/stream") {
+                    handleEncodeStream(connection, *req, keepAlive, *owner);
+                } else {
+                    handleDecodeStream(connection, *req, keepAlive, *owner);
                 }
+            } catch (const exception& e) {
+                LogLine(kLogError) << "[ERROR] Exception in " << req->path << ": " << e.what();
             }
+        });
+        // The body was never read, so the connection cannot carry on
+        if (!queued) rejectBusy(connection, *req, kLaneLarge, false, loop);
+        return;
+    }
+    
+    if (bodyFollows) {
+        // A chunked upload to a buffered route is collected under the usual limits
+        BodyReader body(*connection, *req, deadline);
+        result = body.readAll(req->bodyStorage, limits.maxBodyBytes);
+        req->body = StrView(req->bodyStorage);
+        if (result == kRequestTooLarge || result == kRequestTimedOut) {
+            rejectRequest(connection, *req, result, limits);
+            return;
         }
-        
-        // Check if we have all the body data
-        if (headersComplete) {
-            size_t currentBodySize = rawRequest.length() - bodyStartPos;
-            if (contentLength <= 0 || (int)currentBodySize >= contentLength) {
-                break; // Got all data
-            }
-        }
+        if (result != kRequestReady) return;
     }
     
-    if (!headersComplete || rawRequest.empty()) {
-        closesocket(clientSocket);
-        return;
+    if (isComputeRoute(*req)) {
+        WorkLane lane = req->body.length() >= limits.largeRequestBytes ? kLaneLarge : kLaneSmall;
+        MetricsClock::time_point queuedAt = MetricsClock::now();
+        bool queued = loop.workerPool().trySubmit(lane, [connection, req, keepAlive, owner, receivedAt, queuedAt] {
+            recordStage(kStageQueue, queuedAt);
+            respond(connection, *req, keepAlive, *owner, receivedAt);
+        });
+        if (!queued) rejectBusy(connection, *req, lane, keepAlive, loop);
+    } else {
+        respond(connection, *req, keepAlive, loop, receivedAt);
     }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              MAIN
+// ═══════════════════════════════════════════════════════════════════════════════
+
+struct ServerOptions {
+    int port;
+    size_t workerThreads;       // encode/decode jobs
+    size_t ioThreads;           // request parsing and static files
+    int keepAliveTimeout;       // seconds an idle connection stays open
+    unsigned maxRequests;       // per connection before it is closed
+    int cacheMaxAge;            // Cache-Control max-age for static files
+    LogLevel logLevel;          // most verbose level written
+    size_t resultCacheMB;       // encode result cache budget, 0 disables it
+    RequestLimits limits;       // body size, large-job threshold, I/O timeout
+    size_t largeWorkers;        // workers that may run large jobs, 0 = all but one
+    size_t maxQueued;           // small jobs waiting before 503s
+    size_t maxQueuedLarge;      // large jobs waiting before 429s
     
-    HttpRequest req = parseRequest(rawRequest);
+    ServerOptions() 
+        : port(8080), workerThreads(max(1u, thread::hardware_concurrency())), ioThreads(4),
+          keepAliveTimeout(15), maxRequests(1000), cacheMaxAge(0), logLevel(kLogInfo),
+          resultCacheMB(64), largeWorkers(0), maxQueued(1024), maxQueuedLarge(64) {}
+};
 
-    cout << "[" << getTimestamp() << "] " << req.method << " " << req.path;
-    if (req.contentLength > 0) {
-        cout << " (Content-Length: " << req.contentLength << ", received: " << req.body.length() << ")";
+// Built-in models plus one per training file in ./models/
+void loadStaticModels(const string& directory) {
+    ModelRegistry& registry = staticModels();
+    registry.addBuiltIns();
+    
+    vector<string> paths;
+    listFiles(directory, "", paths);
+    for (size_t i = 0; i < paths.size(); i++) {
+        string name = paths[i].substr(paths[i].rfind('/') + 1);
+        name = name.substr(0, name.rfind('.'));
+        MappedFile corpus;
+        string error;
+        if (!corpus.open(directory + paths[i], error)) {
+            cerr << error << endl;
+            continue;
+        }
+        if (!registry.add(name, directory + paths[i], corpus.data(), corpus.length())) {
+            cerr << "Skipping model file " << directory + paths[i] << " (invalid name)" << endl;
+        }
     }
-    cout << endl;
+}
+
+static const char* kCommandUsage = 
+    "compress IN OUT [--block-size N] [--max-code-length N] [--streams 1|4] [--table block|shared]\n"
+    "       [--model NAME] [--checksum crc32c|none]\n"
+    "       decompress IN OUT";
+
+bool parseCommandOptions(int argc, char** argv, FrameOptions& options) {
+    for (int i = 4; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << endl;
+            return false;
+        }
+        string value = argv[++i];
+        if (arg == "--block-size") {
+            options.blockSize = (size_t)strtoull(value.c_str(), nullptr, 10);
+            if (options.blockSize < 1 || options.blockSize > kMaxBlockSize) {
+                cerr << "--block-size must be between 1 and " << kMaxBlockSize << endl;
+                return false;
+            }
+        } else if (arg == "--max-code-length") {
+            int maxCodeLength = atoi(value.c_str());
+            if (maxCodeLength < 1 || maxCodeLength > (int)kMaxCodeLength) {
+                cerr << "--max-code-length must be between 1 and " << kMaxCodeLength << endl;
+                return false;
+            }
+            options.maxCodeLength = maxCodeLength;
+        } else if (arg == "--streams" && (value == "1" || value == "4")) {
+            options.interleaved = value == "4";
+        } else if (arg == "--table" && (value == "block" || value == "shared")) {
+            options.sharedTable = value == "shared";
+        } else if (arg == "--checksum" && (value == "crc32c" || value == "none")) {
+            options.checksum = value == "crc32c";
+        } else if (arg == "--model") {
+            options.model = staticModels().find(value);
+            if (!options.model) {
+                cerr << "Unknown model '" << value << "'" << endl;
+                return false;
+            }
+        } else {
+            cerr << "Invalid option: " << arg << " " << value << endl;
+            return false;
+        }
+    }
+    return true;
+}
 
-    string response;
+/**
+ * Batch mode: "compress IN OUT" / "decompress IN OUT" convert a file to or
+ * from a HUFB frame without starting the server. The input is mapped and
+ * the blocks are coded in parallel straight from the mapped pages.
+ */
+int runFileCommand(int argc, char** argv) {
+    string command = argv[1];
+    if (argc < 4 || (command == "decompress" && argc != 4)) {
+        cerr << "Usage: " << argv[0] << " " << kCommandUsage << endl;
+        return 1;
+    }
+    loadStaticModels("./models");
+    FrameOptions options;
+    if (command == "compress" && !parseCommandOptions(argc, argv, options)) {
+        cerr << "Usage: " << argv[0] << " " << kCommandUsage << endl;
+        return 1;
+    }
     
-    // Handle OPTIONS (CORS preflight)
-    if (req.method == "OPTIONS") {
-        response = createResponse(204, "text/plain", "");
+    MappedFile input;
+    string output, error;
+    bool verified = false;
+    if (!input.open(argv[2], error)) {
+        cerr << error << endl;
+        return 1;
     }
-    // API Endpoints
-    else if (req.path == "/api/status" && req.method == "GET") {
-        response = createResponse(200, "application/json", 
-            "{\"status\":\"running\",\"backend\":\"C++\",\"version\":\"1.0\"}");
+    
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (command == "compress") {
+        output = encodeFrame(input.data(), input.length(), options, codingPool());
+    } else if (!decodeFrame(input.data(), input.length(), output, error, codingPool(), &verified)) {
+        cerr << argv[2] << ": " << error << endl;
+        return 1;
     }
-    else if (req.path == "/api/encode" && req.method == "POST") {
-        string text = req.body;
-        
-        cout << "  [ENCODE] Input length: " << text.length() << " chars" << endl;
-        
-        if (text.empty()) {
-            response = createResponse(400, "application/json", 
-                "{\"error\":\"No text provided\"}");
-        } else {
-            coder.reset();
-            coder.calculateFrequencies(text);
-            coder.buildTree();
-            
-            string encoded = coder.encode(text);
-            
-            cout << "  [ENCODE] Output length: " << encoded.length() << " bits" << endl;
-            
-            stringstream jsonResponse;
-            jsonResponse << "{";
-            jsonResponse << "\"encoded\":\"" << encoded << "\",";
-            jsonResponse << "\"frequencies\":" << coder.getFrequenciesJson() << ",";
-            jsonResponse << "\"codes\":" << coder.getCodesJson() << ",";
-            jsonResponse << "\"tree\":" << coder.getTreeJson() << ",";
-            jsonResponse << "\"stats\":{";
-            jsonResponse << "\"originalBits\":" << coder.getOriginalBits(text) << ",";
-            jsonResponse << "\"encodedBits\":" << coder.getEncodedBits(encoded) << ",";
-            jsonResponse << "\"compressionRatio\":" << fixed << setprecision(2) 
-                        << coder.getCompressionRatio(text, encoded) << ",";
-            jsonResponse << "\"uniqueChars\":" << coder.getUniqueChars();
-            jsonResponse << "}";
-            jsonResponse << "}";
-            
-            response = createResponse(200, "application/json", jsonResponse.str());
-        }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    
+    if (!writeFile(argv[3], output, error)) {
+        cerr << error << endl;
+        return 1;
     }
-    else if (req.path == "/api/decode" && req.method == "POST") {
-        // Extract encoded from JSON body
-        size_t encodedStart = req.body.find("\"encoded\":\"");
-        if (encodedStart == string::npos) {
-            cout << "  [DECODE] ERROR: 'encoded' field not found in body" << endl;
-            response = createResponse(400, "application/json", 
-                "{\"error\":\"Invalid request format - 'encoded' field not found\"}");
-        } else {
-            encodedStart += 11;
-            size_t encodedEnd = req.body.find("\"", encodedStart);
-            if (encodedEnd == string::npos) {
-                cout << "  [DECODE] ERROR: Malformed JSON" << endl;
-                response = createResponse(400, "application/json", 
-                    "{\"error\":\"Invalid request format - malformed JSON\"}");
-            } else {
-                string encoded = req.body.substr(encodedStart, encodedEnd - encodedStart);
-                
-                cout << "  [DECODE] Input length: " << encoded.length() << " bits" << endl;
-                
-                string decoded = coder.decode(encoded);
-                
-                cout << "  [DECODE] Output length: " << decoded.length() << " chars" << endl;
-                
-                // Verify against original
-                string original = coder.getLastEncodedText();
-                bool match = (decoded == original);
-                cout << "  [DECODE] Match with original: " << (match ? "YES" : "NO") << endl;
-                
-                stringstream jsonResponse;
-                jsonResponse << "{\"decoded\":\"" << escapeJsonString(decoded) << "\"}";
-                
-                response = createResponse(200, "application/json", jsonResponse.str());
+    uint64_t rawBytes = command == "compress" ? input.length() : output.length();
+    cout << argv[2] << " (" << input.length() << " bytes) -> " << argv[3] << " (" << output.length() 
+         << " bytes), " << fixed << setprecision(1) << rawBytes / 1e6 / max(seconds, 1e-9) << " MB/s"
+         << (verified ? ", checksums verified" : "") << endl;
+    return 0;
+}
+
+static const char* kUsage = 
+    "[--port N] [--threads N] [--io-threads N] [--keep-alive SECONDS] [--max-requests N]\n"
+    "       [--cache-max-age SECONDS] [--log-level error|warn|info|debug] [--result-cache MB]\n"
+    "       [--max-body KB] [--large-request KB] [--large-workers N] [--max-queued N]\n"
+    "       [--max-queued-large N] [--io-timeout SECONDS]";
+
+bool parseServerOptions(int argc, char** argv, ServerOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << endl;
+            return false;
+        }
+        if (arg == "--log-level") {
+            if (!parseLogLevel(argv[++i], options.logLevel)) {
+                cerr << "Invalid log level: " << argv[i] << endl;
+                return false;
             }
+            continue;
         }
-    }
-    // Serve static files
-    else {
-        string path = req.path;
-        if (path == "/") path = "/index.html";
-        
-        string filePath = "./web" + path;
-        string content = readFile(filePath);
-        
-        if (!content.empty()) {
-            response = createResponse(200, getContentType(path), content);
+        int value = atoi(argv[++i]);
+        if (arg == "--port" && value > 0 && value < 65536) {
+            options.port = value;
+        } else if (arg == "--threads" && value > 0) {
+            options.workerThreads = value;
+        } else if (arg == "--io-threads" && value > 0) {
+            options.ioThreads = value;
+        } else if (arg == "--keep-alive" && value > 0) {
+            options.keepAliveTimeout = value;
+        } else if (arg == "--max-requests" && value > 0) {
+            options.maxRequests = value;
+        } else if (arg == "--cache-max-age" && value >= 0) {
+            options.cacheMaxAge = value;
+        } else if (arg == "--result-cache" && value >= 0) {
+            options.resultCacheMB = value;
+        } else if (arg == "--max-body" && value > 0) {
+            options.limits.maxBodyBytes = (size_t)value << 10;
+        } else if (arg == "--large-request" && value > 0) {
+            options.limits.largeRequestBytes = (size_t)value << 10;
+        } else if (arg == "--large-workers" && value > 0) {
+            options.largeWorkers = value;
+        } else if (arg == "--max-queued" && value > 0) {
+            options.maxQueued = value;
+        } else if (arg == "--max-queued-large" && value > 0) {
+            options.maxQueuedLarge = value;
+        } else if (arg == "--io-timeout" && value > 0) {
+            options.limits.ioTimeoutMs = value * 1000;
         } else {
-            response = createResponse(404, "text/html", 
-                "<h1>404 Not Found</h1><p>The requested file was not found.</p>");
+            cerr << "Invalid option: " << arg << " " << argv[i] << endl;
+            return false;
         }
     }
-    
-    send(clientSocket, response.c_str(), response.length(), 0);
-    closesocket(clientSocket);
+    return true;
 }
 
-int main() {
+int main(int argc, char** argv) {
+    if (argc > 1 && (strcmp(argv[1], "compress") == 0 || strcmp(argv[1], "decompress") == 0)) {
+        return runFileCommand(argc, argv);
+    }
+    
+    ServerOptions options;
+    if (!parseServerOptions(argc, argv, options)) {
+        cerr << "Usage: " << argv[0] << " " << kUsage << endl;
+        return 1;
+    }
+    logger().setLevel(options.logLevel);
+
 #ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
 #endif
@@ -680,14 +4766,8 @@ int main() {
 ║                                                                              ║
 ╠══════════════════════════════════════════════════════════════════════════════╣
 ║                                                                              ║
-║   Server running at: http://localhost:8080                                   ║
-║                                                                              ║
-║   API Endpoints:                                                             ║
-║     POST /api/encode  - Encode text using Huffman coding                     ║
-║     POST /api/decode  - Decode binary back to text                           ║
-║     GET  /api/status  - Check server status                                  ║
-║                                                                              ║
-║   Frontend: http://localhost:8080                                            ║
+║   Web interface and API on the address logged below; see README.md for       ║
+║   the endpoints                                                              ║
 ║                                                                              ║
 ║   Press Ctrl+C to stop the server                                            ║
 ║                                                                              ║
@@ -700,6 +4780,9 @@ int main() {
         cerr << "WSAStartup failed" << endl;
         return 1;
     }
+#else
+    // A peer closing mid-response must not kill the process
+    signal(SIGPIPE, SIG_IGN);
 #endif
 
     SOCKET serverSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
@@ -717,10 +4800,10 @@ int main() {
     sockaddr_in serverAddr;
     serverAddr.sin_family = AF_INET;
     serverAddr.sin_addr.s_addr = INADDR_ANY;
-    serverAddr.sin_port = htons(8080);
+    serverAddr.sin_port = htons((uint16_t)options.port);
 
     if (bind(serverSocket, (sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
-        cerr << "Bind failed. Port 8080 may be in use." << endl;
+        cerr << "Bind failed. Port " << options.port << " may be in use." << endl;
         closesocket(serverSocket);
 #ifdef _WIN32
         WSACleanup();
@@ -737,32 +4820,45 @@ int main() {
         return 1;
     }
 
-    cout << "[" << getTimestamp() << "] Server listening on http://localhost:8080" << endl;
-    cout << "[" << getTimestamp() << "] Serving static files from ./web/" << endl;
-    cout << endl;
-
-    while (true) {
-        sockaddr_in clientAddr;
-        int clientAddrLen = sizeof(clientAddr);
-        
-        SOCKET clientSocket = accept(serverSocket, (sockaddr*)&clientAddr, &clientAddrLen);
-        
-        if (clientSocket == INVALID_SOCKET) {
-            continue;
-        }
+    ThreadPool ioPool(options.ioThreads);
+    size_t largeWorkers = options.largeWorkers ? options.largeWorkers 
+                                               : max((size_t)1, options.workerThreads - 1);
+    WorkerPool workerPool(options.workerThreads, largeWorkers, options.maxQueued, options.maxQueuedLarge);
+    EventLoop loop(serverSocket, ioPool, workerPool, options.keepAliveTimeout * 1000, options.maxRequests,
+                   options.limits);
+    metrics().ioPool = &ioPool;
+    metrics().workerPool = &workerPool;
+    if (!loop.valid()) {
+        cerr << "Failed to create event loop" << endl;
+        closesocket(serverSocket);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return 1;
+    }
 
-        try {
-            handleClient(clientSocket);
-        } catch (const exception& e) {
-            cerr << "[ERROR] Exception in handleClient: " << e.what() << endl;
-            cerr.flush();
-            try { closesocket(clientSocket); } catch (...) {}
-        } catch (...) {
-            cerr << "[ERROR] Unknown exception in handleClient" << endl;
-            cerr.flush();
-            try { closesocket(clientSocket); } catch (...) {}
-        }
+    cout << "[" << getTimestamp() << "] Server listening on http://localhost:" << options.port << endl;
+    cout << "[" << getTimestamp() << "] Event loop: " << EventLoop::backendName() 
+         << ", " << options.ioThreads << " I/O threads, " << options.workerThreads << " worker threads, " 
+         << codingKernels().name << " coding kernels" << endl;
+    cout << "[" << getTimestamp() << "] Keep-alive: " << options.keepAliveTimeout << "s idle, " 
+         << options.maxRequests << " requests per connection" << endl;
+    cout << "[" << getTimestamp() << "] Admission: bodies up to " << (options.limits.maxBodyBytes >> 10) 
+         << " KB, large lane from " << (options.limits.largeRequestBytes >> 10) << " KB on " 
+         << workerPool.largeWorkers() << " workers, queues " << options.maxQueued << "/" 
+         << options.maxQueuedLarge << ", " << options.limits.ioTimeoutMs / 1000 << "s I/O timeout" << endl;
+    loadStaticModels("./models");
+    cout << "[" << getTimestamp() << "] Static models: " << staticModels().count() << " loaded" << endl;
+    staticAssets().load("./web", options.cacheMaxAge);
+    cout << "[" << getTimestamp() << "] Serving static files from ./web/ (" << staticAssets().count() 
+         << " cached, " << staticAssets().cachedBytes() / 1024 << " KB)" << endl;
+    resultCache().setCapacity(options.resultCacheMB << 20);
+    if (resultCache().enabled()) {
+        cout << "[" << getTimestamp() << "] Encode result cache: " << options.resultCacheMB << " MB" << endl;
     }
+    cout << endl;
+
+    loop.run();
 
     closesocket(serverSocket);
 #ifdef _WIN32
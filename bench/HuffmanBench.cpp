@@ -0,0 +1,641 @@
+/**
+ * ╔══════════════════════════════════════════════════════════════════════════════╗
+ * ║                     HUFFMAN CODER - BENCHMARKS                               ║
+ * ╚══════════════════════════════════════════════════════════════════════════════╝
+ *
+ * Micro-benchmarks for the coding engine (HuffmanCoder.h) and a load
+ * generator for a running server.
+ *
+ * Compile: g++ -O2 -std=c++11 -o HuffmanBench bench/HuffmanBench.cpp -lws2_32
+ *          (Linux/macOS: g++ -O2 -std=c++11 -o HuffmanBench bench/HuffmanBench.cpp -pthread)
+ * Run: ./HuffmanBench [--max-size 16M] [--corpus text|logs|binary|skewed|uniform]
+ *                     [--min-time 200] [--kernels scalar|bmi2]
+ *      ./HuffmanBench load [--host 127.0.0.1] [--port 8080] [--connections 16]
+ *                          [--requests 10000] [--size 1000] [--endpoint encode|decode|both]
+ *
+ * Sizes go from 100 B up to --max-size (1G for the full sweep). Each result
+ * shows time per operation, MB/s of input, cycles per byte (x86 time stamp
+ * counter) and heap allocations per operation; the engine rows (staticEnc,
+ * adaptiveEnc, ...) also show the coded size in bits per input byte,
+ * tables included; crc32c is the frame block checksum. --kernels runs the coder with a given kernel set
+ * instead of the one picked for this CPU.
+ */
+
+#ifdef _WIN32
+    #define _WIN32_WINNT 0x0601
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #pragma comment(lib, "ws2_32.lib")
+#else
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <arpa/inet.h>
+    #include <netdb.h>
+    #include <unistd.h>
+    #define closesocket close
+    #define SOCKET int
+    #define INVALID_SOCKET -1
+#endif
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <new>
+#include <cstdlib>
+#include <cstdio>
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+    #define HUFFMAN_HAVE_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define HUFFMAN_HAVE_RDTSC
+#endif
+
+#include "../HuffmanCoder.h"
+
+using namespace std;
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              ALLOCATION COUNTING
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Every operator new in the process is counted, so a benchmark can report
+ * how many heap allocations one operation makes.
+ */
+static atomic<uint64_t> allocationCount(0);
+
+// GCC flags free() on memory from operator new, not knowing it is replaced
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+    #pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    void* p = malloc(size == 0 ? 1 : size);
+    if (!p) throw bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              TIMING
+// ═══════════════════════════════════════════════════════════════════════════════
+
+typedef chrono::steady_clock Clock;
+
+static uint64_t readCycles() {
+#ifdef HUFFMAN_HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+struct Measurement {
+    double secondsPerOp;
+    double cyclesPerOp;
+    double allocationsPerOp;
+};
+
+// Runs op until minTime has passed (at least once) and averages
+template <typename Op>
+Measurement measure(Op op, double minTime) {
+    op();                                       // warm caches and page in buffers
+
+    uint64_t iterations = 0;
+    uint64_t allocationsBefore = allocationCount.load();
+    uint64_t cyclesBefore = readCycles();
+    Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    do {
+        op();
+        iterations++;
+        elapsed = chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < minTime);
+
+    Measurement m;
+    m.secondsPerOp = elapsed / iterations;
+    m.cyclesPerOp = (double)(readCycles() - cyclesBefore) / iterations;
+    m.allocationsPerOp = (double)(allocationCount.load() - allocationsBefore) / iterations;
+    return m;
+}
+
+// Keeps results observable so the optimizer cannot drop the work
+static volatile uint64_t benchSink = 0;
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              CORPUS
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Deterministic synthetic inputs, so runs on different machines compare:
+ *   text     English-like words with Zipf-ish frequencies
+ *   logs     timestamped server log lines
+ *   binary   little-endian records of small integers and floats
+ *   skewed   geometric byte distribution (a few bytes dominate)
+ *   uniform  uniformly random bytes (incompressible)
+ */
+class Random {
+private:
+    uint64_t state;
+
+public:
+    explicit Random(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+    uint64_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    unsigned below(unsigned n) {
+        return (unsigned)(next() % n);
+    }
+};
+
+static const char* const kWords[] = {
+    "the", "of", "and", "to", "a", "in", "is", "it", "you", "that", "he", "was", "for", "on",
+    "are", "with", "as", "his", "they", "be", "at", "one", "have", "this", "from", "or", "had",
+    "by", "word", "but", "what", "some", "we", "can", "out", "other", "were", "all", "there",
+    "when", "up", "use", "your", "how", "said", "each", "which", "their", "time", "will",
+    "about", "many", "then", "them", "write", "would", "like", "these", "long", "make", "thing",
+    "see", "look", "more", "day", "could", "number", "sound", "people", "water", "called",
+    "encoding", "compression", "Huffman", "frequency", "symbol", "server", "request", "buffer"
+};
+
+static string generateCorpus(const string& kind, size_t size) {
+    Random random(size + kind.length());
+    string out;
+    out.reserve(size + 256);
+    size_t wordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+    while (out.size() < size) {
+        if (kind == "text") {
+            // Squaring the uniform pick favours the front of the list
+            unsigned r = random.below(1000);
+            out += kWords[(size_t)r * r / 1000 * wordCount / 1000];
+            unsigned punctuation = random.below(20);
+            out += punctuation == 0 ? ". " : punctuation == 1 ? ", " : punctuation == 2 ? "\n" : " ";
+        } else if (kind == "logs") {
+            static const char* const levels[] = { "INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR" };
+            static const char* const paths[] = { "/api/encode", "/api/decode", "/api/status", "/index.html" };
+            char line[160];
+            uint64_t ms = 1718031123000ull + out.size() / 7;
+            snprintf(line, sizeof(line),
+                     "2024-06-10T%02u:%02u:%02u.%03uZ %s [worker-%u] %s status=%u bytes=%u latency=%ums\n",
+                     (unsigned)(ms / 3600000 % 24), (unsigned)(ms / 60000 % 60), (unsigned)(ms / 1000 % 60),
+                     (unsigned)(ms % 1000), levels[random.below(6)], random.below(8),
+                     paths[random.below(4)], random.below(10) == 0 ? 404u : 200u,
+                     random.below(65536), random.below(250));
+            out += line;
+        } else if (kind == "binary") {
+            uint32_t record[4] = { random.below(256), random.below(65536), (uint32_t)random.next(), 0 };
+            float value = (float)random.below(100000) / 100.0f;
+            memcpy(&record[3], &value, 4);
+            out.append((const char*)record, sizeof(record));
+        } else if (kind == "skewed") {
+            uint64_t bits = random.next();
+            for (int i = 0; i < 8; i++) {
+                unsigned zeros = 0;
+                while (zeros < 7 && ((bits >> (i * 8 + zeros)) & 1) == 0) zeros++;
+                out += (char)('a' + zeros);
+            }
+        } else {
+            uint64_t bits = random.next();
+            out.append((const char*)&bits, 8);
+        }
+    }
+    out.resize(size);
+    return out;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              MICRO-BENCHMARKS
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static const uint64_t kSizes[] = {
+    100, 1 << 10, 16 << 10, 256 << 10, 1 << 20, 16 << 20, 256 << 20, 1ull << 30
+};
+static const size_t kMaxBitStringSize = 16 * 1024 * 1024;   // '0'/'1' strings are 8x the input
+
+static string formatSize(uint64_t bytes) {
+    static const char* const units[] = { "B", "K", "M", "G" };
+    int unit = 0;
+    while (unit < 3 && bytes >= 1024 && bytes % 1024 == 0) {
+        bytes /= 1024;
+        unit++;
+    }
+    return to_string(bytes) + units[unit];
+}
+
+static void printHeader() {
+    cout << left << setw(12) << "operation" << setw(9) << "corpus" << right << setw(7) << "size"
+         << setw(14) << "time/op" << setw(12) << "MB/s" << setw(10) << "cyc/B"
+         << setw(11) << "allocs/op" << setw(9) << "bits/B" << endl;
+    cout << string(84, '-') << endl;
+}
+
+// bitsPerByte is the compressed size, for the rows that produce output to compare
+static void report(const string& operation, const string& corpus, size_t bytes, const Measurement& m,
+                   double bitsPerByte = -1) {
+    double us = m.secondsPerOp * 1e6;
+    cout << left << setw(12) << operation << setw(9) << corpus << right << setw(7) << formatSize(bytes);
+    cout << fixed << setprecision(us < 10 ? 3 : 1) << setw(12) << us << "us";
+    cout << setprecision(1) << setw(12) << (double)bytes / m.secondsPerOp / 1e6;
+#ifdef HUFFMAN_HAVE_RDTSC
+    cout << setprecision(2) << setw(10) << m.cyclesPerOp / (double)bytes;
+#else
+    cout << setw(10) << "-";
+#endif
+    cout << setprecision(1) << setw(11) << m.allocationsPerOp;
+    if (bitsPerByte >= 0) {
+        cout << setprecision(3) << setw(9) << bitsPerByte;
+    }
+    cout << endl;
+}
+
+static void benchmarkCorpus(const string& corpus, size_t size, double minTime) {
+    string input = generateCorpus(corpus, size);
+
+    HuffmanCoder coder;
+    report("histogram", corpus, size, measure([&]() {
+        coder.calculateFrequencies(input);
+    }, minTime));
+
+    report("buildTree", corpus, size, measure([&]() {
+        coder.buildTree();
+    }, minTime));
+
+    uint64_t bitLength = 0;
+    string packed = coder.encodePacked(input, bitLength);
+    report("encode", corpus, size, measure([&]() {
+        string out;
+        benchSink += coder.encodePacked(input.data(), input.length(), out);
+    }, minTime));
+
+    report("decode", corpus, size, measure([&]() {
+        benchSink += coder.decodePacked(packed, bitLength).length();
+    }, minTime));
+
+    // Block checksum that frames verify after each decoded block
+    report("crc32c", corpus, size, measure([&]() {
+        benchSink += crc32c(input.data(), input.length());
+    }, minTime));
+
+    // Four interleaved streams, as in frames and streams with streams=4
+    string streams[4];
+    const char* streamBytes[4];
+    size_t streamSizes[4];
+    uint64_t streamBits[4];
+    char* outputs[4];
+    size_t counts[4];
+    string decoded(size, '\0');
+    size_t quarter = (size + 3) / 4;
+    for (int s = 0; s < 4; s++) {
+        size_t start = min(s * quarter, size);
+        counts[s] = min(start + quarter, size) - start;
+        streamBits[s] = coder.encodePacked(input.data() + start, counts[s], streams[s]);
+        streamBytes[s] = streams[s].data();
+        streamSizes[s] = streams[s].size();
+        outputs[s] = &decoded[start];
+    }
+    report("decode4", corpus, size, measure([&]() {
+        benchSink += coder.getDecodeTable().decodeInterleaved(streamBytes, streamSizes, streamBits, 
+                                                              outputs, counts);
+    }, minTime));
+
+    if (size <= kMaxBitStringSize) {
+        string bits = coder.encode(input);
+        report("encodeBits", corpus, size, measure([&]() {
+            benchSink += coder.encode(input).length();
+        }, minTime));
+        report("decodeBits", corpus, size, measure([&]() {
+            benchSink += coder.decode(bits).length();
+        }, minTime));
+    }
+
+    // Whole messages through each engine: static is histogram + tree + code
+    // with its table counted in the size, adaptive is one pass with no table
+    for (size_t e = 0; e < kCodingEngineCount && size <= kMaxBitStringSize; e++) {
+        const CodingEngine& engine = kCodingEngines[e];
+        string table, coded;
+        uint64_t bits = engine.encode(input.data(), input.length(), kDefaultMaxCodeLength, table, coded);
+        double bitsPerByte = (double)(bits + table.length() * 8) / (double)size;
+        report(string(engine.name) + "Enc", corpus, size, measure([&]() {
+            string ignored, out;
+            benchSink += engine.encode(input.data(), input.length(), kDefaultMaxCodeLength, ignored, out);
+        }, minTime), bitsPerByte);
+        report(string(engine.name) + "Dec", corpus, size, measure([&]() {
+            string out;
+            benchSink += engine.decode(coded.data(), coded.size(), bits, table, out) ? out.length() : 0;
+        }, minTime), bitsPerByte);
+    }
+
+    // The visualization sections depend on the alphabet, not the input size
+    report("jsonTables", corpus, size, measure([&]() {
+        JsonWriter json(16384);
+        json.beginObject();
+        coder.writeFrequencies(json.key("frequencies"));
+        coder.writeCodes(json.key("codes"));
+        coder.writeTree(json.key("tree"));
+        json.endObject();
+        benchSink += json.str().length();
+    }, minTime));
+
+    report("jsonEscape", corpus, size, measure([&]() {
+        JsonWriter json(input.length() + input.length() / 8 + 32);
+        json.beginObject().key("decoded").value(input).endObject();
+        benchSink += json.str().length();
+    }, minTime));
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              LOAD GENERATOR
+// ═══════════════════════════════════════════════════════════════════════════════
+
+/**
+ * Each connection is a thread with one keep-alive socket that sends a
+ * request, waits for the whole response and records the latency, until
+ * --requests have been sent in total.
+ */
+struct LoadOptions {
+    string host;
+    int port;
+    unsigned connections;
+    unsigned requests;
+    size_t size;
+    string endpoint;
+
+    LoadOptions() : host("127.0.0.1"), port(8080), connections(16), requests(10000),
+                    size(1000), endpoint("both") {}
+};
+
+static SOCKET connectTo(const LoadOptions& options) {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* address = nullptr;
+    if (getaddrinfo(options.host.c_str(), to_string(options.port).c_str(), &hints, &address) != 0) {
+        return INVALID_SOCKET;
+    }
+
+    SOCKET s = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+    if (s != INVALID_SOCKET && connect(s, address->ai_addr, (int)address->ai_addrlen) != 0) {
+        closesocket(s);
+        s = INVALID_SOCKET;
+    }
+    freeaddrinfo(address);
+
+    if (s != INVALID_SOCKET) {
+        int noDelay = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+    }
+    return s;
+}
+
+// Sends one request and reads the response body; false on any failure
+static bool roundTrip(SOCKET s, const string& request, string& buffer, string& body, int& status) {
+    size_t sent = 0;
+    while (sent < request.length()) {
+        int n = send(s, request.data() + sent, (int)(request.length() - sent), 0);
+        if (n <= 0) return false;
+        sent += n;
+    }
+
+    char chunk[16384];
+    size_t headerEnd;
+    while ((headerEnd = buffer.find("\r\n\r\n")) == string::npos) {
+        int n = recv(s, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+    }
+
+    status = atoi(buffer.c_str() + 9);                 // "HTTP/1.1 200"
+    size_t lengthPos = buffer.find("Content-Length: ");
+    if (lengthPos == string::npos || lengthPos > headerEnd) return false;
+    size_t length = strtoull(buffer.c_str() + lengthPos + 16, nullptr, 10);
+
+    size_t total = headerEnd + 4 + length;
+    while (buffer.length() < total) {
+        int n = recv(s, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+    }
+    body.assign(buffer, headerEnd + 4, length);
+    buffer.erase(0, total);
+    return true;
+}
+
+static string buildRequest(const LoadOptions& options, const string& path,
+                           const string& contentType, const string& body) {
+    return "POST " + path + " HTTP/1.1\r\nHost: " + options.host +
+           "\r\nContent-Type: " + contentType + "\r\nContent-Length: " + to_string(body.length()) +
+           "\r\n\r\n" + body;
+}
+
+static string jsonField(const string& json, const string& key) {
+    size_t pos = json.find("\"" + key + "\":");
+    if (pos == string::npos) return "";
+    pos += key.length() + 3;
+    if (json[pos] == '"') {
+        return json.substr(pos + 1, json.find('"', pos + 1) - pos - 1);
+    }
+    return json.substr(pos, json.find_first_of(",}", pos) - pos);
+}
+
+static double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[min(index, sorted.size() - 1)];
+}
+
+static int runLoad(const LoadOptions& options) {
+    string text = generateCorpus("text", options.size);
+    string encodeRequest = buildRequest(options, "/api/encode?format=base64", "text/plain", text);
+
+    // One encode up front gives the payload for the decode requests
+    SOCKET probe = connectTo(options);
+    string buffer, body;
+    int status = 0;
+    if (probe == INVALID_SOCKET || !roundTrip(probe, encodeRequest, buffer, body, status) || status != 200) {
+        cerr << "Cannot reach http://" << options.host << ":" << options.port << "/api/encode" << endl;
+        if (probe != INVALID_SOCKET) closesocket(probe);
+        return 1;
+    }
+    closesocket(probe);
+    string decodeBody = "{\"packed\":\"" + jsonField(body, "packed") + "\",\"bitLength\":" +
+                        jsonField(body, "bitLength") + ",\"table\":\"" + jsonField(body, "table") + "\"}";
+    string decodeRequest = buildRequest(options, "/api/decode", "application/json", decodeBody);
+
+    atomic<unsigned> issued(0);
+    atomic<unsigned> failures(0);
+    vector<vector<double> > encodeLatencies(options.connections);
+    vector<vector<double> > decodeLatencies(options.connections);
+    vector<thread> clients;
+
+    Clock::time_point start = Clock::now();
+    for (unsigned c = 0; c < options.connections; c++) {
+        clients.push_back(thread([&, c]() {
+            SOCKET s = connectTo(options);
+            string buffer, body;
+            int status = 0;
+            while (s != INVALID_SOCKET) {
+                unsigned n = issued.fetch_add(1);
+                if (n >= options.requests) break;
+
+                bool decode = options.endpoint == "decode" || (options.endpoint == "both" && n % 2 == 1);
+                Clock::time_point sentAt = Clock::now();
+                if (!roundTrip(s, decode ? decodeRequest : encodeRequest, buffer, body, status) || status != 200) {
+                    failures++;
+                    closesocket(s);
+                    buffer.clear();
+                    s = connectTo(options);
+                    continue;
+                }
+                double ms = chrono::duration<double, milli>(Clock::now() - sentAt).count();
+                (decode ? decodeLatencies : encodeLatencies)[c].push_back(ms);
+            }
+            if (s != INVALID_SOCKET) closesocket(s);
+        }));
+    }
+    for (size_t i = 0; i < clients.size(); i++) clients[i].join();
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+    cout << options.connections << " connections, " << options.requests << " requests, "
+         << options.size << " byte messages, " << fixed << setprecision(2) << seconds << "s" << endl;
+    cout << left << setw(10) << "endpoint" << right << setw(10) << "requests" << setw(11) << "req/s"
+         << setw(10) << "p50 ms" << setw(10) << "p90 ms" << setw(10) << "p99 ms" << setw(10) << "max ms" << endl;
+
+    const char* names[2] = { "encode", "decode" };
+    vector<vector<double> >* latencies[2] = { &encodeLatencies, &decodeLatencies };
+    for (int e = 0; e < 2; e++) {
+        vector<double> all;
+        for (size_t c = 0; c < latencies[e]->size(); c++) {
+            all.insert(all.end(), (*latencies[e])[c].begin(), (*latencies[e])[c].end());
+        }
+        if (all.empty()) continue;
+        sort(all.begin(), all.end());
+        cout << left << setw(10) << names[e] << right << setw(10) << all.size()
+             << setprecision(0) << setw(11) << all.size() / seconds << setprecision(3)
+             << setw(10) << percentile(all, 0.50) << setw(10) << percentile(all, 0.90)
+             << setw(10) << percentile(all, 0.99) << setw(10) << all.back() << endl;
+    }
+    if (failures > 0) cout << failures << " failed requests" << endl;
+    return failures > 0 ? 1 : 0;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+//                              MAIN
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Sizes like 100, 64K, 16M, 1G
+static uint64_t parseSize(const char* text) {
+    char* end = nullptr;
+    uint64_t value = strtoull(text, &end, 10);
+    switch (end ? *end : '\0') {
+        case 'K': case 'k': return value << 10;
+        case 'M': case 'm': return value << 20;
+        case 'G': case 'g': return value << 30;
+        default: return value;
+    }
+}
+
+static const char* kUsage =
+    "[--max-size 16M] [--corpus NAME] [--min-time MS] [--kernels NAME]\n"
+    "       load [--host H] [--port N] [--connections N] [--requests N] [--size BYTES] [--endpoint E]";
+
+int main(int argc, char** argv) {
+    bool load = argc > 1 && string(argv[1]) == "load";
+    LoadOptions loadOptions;
+    uint64_t maxSize = 16 << 20;
+    double minTime = 0.2;
+    vector<string> corpora;
+
+    for (int i = load ? 2 : 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Usage: " << argv[0] << " " << kUsage << endl;
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (!load && arg == "--max-size") {
+            maxSize = parseSize(value);
+        } else if (!load && arg == "--corpus") {
+            corpora.push_back(value);
+        } else if (!load && arg == "--min-time") {
+            minTime = atof(value) / 1000;
+        } else if (!load && arg == "--kernels") {
+            if (!selectCodingKernels(value)) {
+                cerr << "Kernels '" << value << "' are not available on this machine" << endl;
+                return 1;
+            }
+        } else if (load && arg == "--host") {
+            loadOptions.host = value;
+        } else if (load && arg == "--port") {
+            loadOptions.port = atoi(value);
+        } else if (load && arg == "--connections" && atoi(value) > 0) {
+            loadOptions.connections = atoi(value);
+        } else if (load && arg == "--requests" && atoi(value) > 0) {
+            loadOptions.requests = atoi(value);
+        } else if (load && arg == "--size" && parseSize(value) > 0) {
+            loadOptions.size = (size_t)parseSize(value);
+        } else if (load && arg == "--endpoint") {
+            loadOptions.endpoint = value;
+        } else {
+            cerr << "Invalid option: " << arg << " " << value << endl;
+            cerr << "Usage: " << argv[0] << " " << kUsage << endl;
+            return 1;
+        }
+    }
+
+    if (load) {
+#ifdef _WIN32
+        WSADATA wsaData;
+        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+            cerr << "WSAStartup failed" << endl;
+            return 1;
+        }
+#endif
+        int result = runLoad(loadOptions);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return result;
+    }
+
+    if (corpora.empty()) {
+        const char* all[] = { "text", "logs", "binary", "skewed", "uniform" };
+        corpora.assign(all, all + 5);
+    }
+
+    cout << "Kernels: " << codingKernels().name << ", checksum: " << checksumKernels().name << endl << endl;
+    printHeader();
+    for (size_t c = 0; c < corpora.size(); c++) {
+        for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]) && kSizes[i] <= maxSize; i++) {
+            benchmarkCorpus(corpora[c], (size_t)kSizes[i], minTime);
+        }
+        cout << endl;
+    }
+    return benchSink == 42 ? 2 : 0;
+}
@@ -143,6 +143,7 @@ function loadBinFile(input) {
                     const parsedCodes = JSON.parse(codesJson);
                     currentCodes = parsedCodes;
                     currentEncodedData = binaryData;
+                    currentTable = '';
                     
                     console.log('Parsed codes:', currentCodes);
                     console.log('Number of codes:', Object.keys(currentCodes).length);
@@ -165,6 +166,7 @@ function loadBinFile(input) {
                     binaryString += bytes[i].toString(2).padStart(8, '0');
                 }
                 currentEncodedData = binaryString;
+                currentTable = '';
                 displayEncodedBinary(binaryString);
                 showToast('Loaded binary file (no codes - encode text first before decoding)', 'warning');
             }
@@ -188,6 +190,7 @@ function loadBinFile(input) {
 // Global state
 let currentEncodedData = '';
 let currentCodes = {};
+let currentTable = '';      // Code-length table from the backend, needed to decode there
 let sortOrder = 'frequency';
 let treeZoom = 1;
 let cppTreeData = null;     // Store tree data from C++ backend
@@ -474,6 +477,7 @@ async function encode() {
         
         currentEncodedData = result.encoded;
         currentCodes = result.codes;
+        currentTable = result.table;
 
         // Update frequency table
         displayFrequencyTable(result.frequencies);
@@ -513,7 +517,7 @@ async function encodeWithCppBackend(text) {
     const timeoutId = setTimeout(() => controller.abort(), 30000); // 30 second timeout
     
     try {
-        const response = await fetch(`${API_BASE}/api/encode`, {
+        const response = await fetch(`${API_BASE}/api/encode?verbose=1`, {
             method: 'POST',
             headers: {
                 'Content-Type': 'text/plain'
@@ -539,6 +543,7 @@ async function encodeWithCppBackend(text) {
         return {
             encoded: data.encoded,
             codes: data.codes,
+            table: data.table || '',
             frequencies: data.frequencies || {},
             tree: data.tree || null,
             stats: {
@@ -995,9 +1000,9 @@ async function decode() {
         
         // Check if we have the original text (meaning we just encoded and haven't uploaded a file)
         const originalText = document.getElementById('inputText').value;
-        const hasOriginalText = originalText && originalText.length > 0;
+        const hasOriginalText = originalText && originalText.length > 0 && currentTable;
         
-        // If we have original text, try backend first (it can use the tree from encoding)
+        // If we have original text, try backend first (it decodes with the table returned by encode)
         // If we uploaded a file (no original text), use client-side decoding with the codes
         if (hasOriginalText) {
             console.log('Has original text - trying backend decode with tree');
@@ -1012,7 +1017,7 @@ async function decode() {
                     },
                     body: JSON.stringify({
                         encoded: currentEncodedData,
-                        codes: currentCodes
+                        table: currentTable
                     }),
                     signal: controller.signal
                 });